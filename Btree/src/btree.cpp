@@ -61,31 +61,31 @@ namespace badgerdb
             file = new BlobFile(indexName,true);
             rootPageNum = 2;
             // Alloc a new page
-            Page* headerPage;
-            bufMgr -> allocPage(file, headerPageNum, headerPage);
-            IndexMetaInfo* metaPage = (IndexMetaInfo*)headerPage;
+            PageHandle headerPage = bufMgr -> allocPage(file, headerPageNum);
+            headerPage.markDirty();
+            IndexMetaInfo* metaPage = (IndexMetaInfo*)headerPage.get();
             // Store data into header page
             strcpy(metaPage -> relationName, relationName.c_str());
             metaPage -> attrByteOffset = attrByteOffset;
             metaPage -> attrType = attrType;
             metaPage -> rootPageNo = 2;
-            bufMgr -> unPinPage(file, headerPageNum, true);
+            headerPage.release();
             // Create a FileScan object to obtain records from relation
             FileScan fc(relationName, bufMgr);
-            // Create the root page
+            // Create the root page, even if the relation turns out to be empty
+            PageHandle rootPage = bufMgr -> allocPage(file, rootPageNum);
             try
             {
                 RecordId scanRid;
-                // get the first record and create a root
+                // get the first record and put it into the root
                 fc.scanNext(scanRid);
                 std::string recordStr = fc.getRecord();
                 const char *record = recordStr.c_str();
-                Page *rootPage;
-                bufMgr -> allocPage(file,rootPageNum,rootPage);
-                LeafNodeInt* rootNode = (LeafNodeInt*)rootPage;
+                LeafNodeInt* rootNode = (LeafNodeInt*)rootPage.get();
+                rootPage.markDirty();
                 rootNode -> keyArray[0] = *((int*)record + attrByteOffset);
                 rootNode -> ridArray[0] = scanRid;
-                bufMgr -> unPinPage(file, rootPageNum, true);
+                rootPage.release();
                 // Get all the records from the relation
                 while (1)
                 {
@@ -98,7 +98,10 @@ namespace badgerdb
             // Hit the end
             catch (EndOfFileException e)
             {
+                rootPage.release();
                 bufMgr -> flushFile(file);
+                // the finished index becomes durable in one go rather than page by page
+                file -> sync();
             }
         }
         // File exists
@@ -106,9 +109,8 @@ namespace badgerdb
         {
             // open && read an existing file
             file = new BlobFile(indexName,false);
-            Page* headerPage;
-            bufMgr -> readPage(file, headerPageNum, headerPage);
-            IndexMetaInfo* metaPage = (IndexMetaInfo*)headerPage;
+            PageHandle headerPage = bufMgr -> readPage(file, headerPageNum);
+            IndexMetaInfo* metaPage = (IndexMetaInfo*)headerPage.get();
             rootPageNum = metaPage -> rootPageNo;
             // The the data of metaPage does not match the initial one
             if (relationName != metaPage -> relationName ||
@@ -116,8 +118,10 @@ namespace badgerdb
             {
                 throw BadIndexInfoException(outIndexName);
             }
-            bufMgr -> unPinPage(file, headerPageNum, true);
+            headerPage.release();
         }
+        // lookups jump between the nodes of the index, so kernel readahead would only waste reads
+        file -> adviseAccess(FileAccess::RANDOM);
     }
     /**
      * BTreeIndex Destructor.
@@ -128,6 +132,7 @@ namespace badgerdb
     BTreeIndex::~BTreeIndex()
     {
         scanExecuting = false;
+        currentPage.release();
         bufMgr -> flushFile(file);
         delete file;
         file = nullptr;
@@ -206,30 +211,38 @@ namespace badgerdb
         highOp = highOpParm;
         // recursively find the exact place to start
         // start from the root
-        Page* tmp;
-        bufMgr -> readPage(file, rootPageNum, tmp);
         bool findKey = false;
-        // if root is leaf, recursively through all record of root is enough
-        if (rootPageNum == 2)
+        PageId leafPageNum;
+        // descend through the non leaf nodes without pinning them if none of them changes meanwhile
+        if (rootPageNum != 2 && findLeafOptimistic(leafPageNum))
         {
-            LeafNodeInt* rootLeaf = (LeafNodeInt*)tmp;
-            findKey = searchKeyInLeaf(rootLeaf, rootPageNum);
+            PageHandle leafPage = bufMgr -> readPage(file, leafPageNum);
+            findKey = searchKeyInLeaf((LeafNodeInt*)leafPage.get(), leafPageNum);
         }
-        // if root is not leaf, recursing through all children of root
         else
         {
-            NonLeafNodeInt* root = (NonLeafNodeInt*)tmp;
-            findKey = findLeafNode(root, root -> level);
+            PageHandle rootPage = bufMgr -> readPage(file, rootPageNum);
+            // if root is leaf, recursively through all record of root is enough
+            if (rootPageNum == 2)
+            {
+                LeafNodeInt* rootLeaf = (LeafNodeInt*)rootPage.get();
+                findKey = searchKeyInLeaf(rootLeaf, rootPageNum);
+            }
+            // if root is not leaf, recursing through all children of root
+            else
+            {
+                NonLeafNodeInt* root = (NonLeafNodeInt*)rootPage.get();
+                findKey = findLeafNode(root, root -> level);
+            }
+            rootPage.release();
         }
-        bufMgr -> unPinPage(file, rootPageNum, false);
         // does not find key
         if (!findKey)
         {
             endScan();
             throw NoSuchKeyFoundException();
         }
-        bufMgr -> readPage(file, currentPageNum, tmp);
-        currentPageData = tmp;
+        currentPage = bufMgr -> readPage(file, currentPageNum);
     }
     /**
 	 * Fetch the record id of the next index entry that matches the scan.
@@ -248,20 +261,26 @@ namespace badgerdb
         {
             throw ScanNotInitializedException();
         }
-        LeafNodeInt* currNode = (LeafNodeInt*) currentPageData;
-        // If the pageNo of next RID == 0 || hit the end of the array
-        if (currNode -> ridArray[nextEntry].page_number == 0 || nextEntry == INTARRAYLEAFSIZE)
+        // The scan has already run off its last page
+        if (!currentPage.isValid())
+        {
+            throw IndexScanCompletedException();
+        }
+        LeafNodeInt* currNode = (LeafNodeInt*) currentPage.get();
+        // If hit the end of the array || the pageNo of next RID == 0
+        if (nextEntry == INTARRAYLEAFSIZE || currNode -> ridArray[nextEntry].page_number == 0)
         {
-            bufMgr -> unPinPage(file, currentPageNum, false);
+            PageId rightSibPageNo = currNode -> rightSibPageNo;
+            currentPage.release();
             // If there is no right sibling page
-            if (currNode -> rightSibPageNo == 0)
+            if (rightSibPageNo == 0)
             {
                 throw IndexScanCompletedException();
             }
             // There is valid sibling page, set data
-            currentPageNum = currNode -> rightSibPageNo;
-            bufMgr -> readPage(file, currentPageNum, currentPageData);
-            currNode = (LeafNodeInt*) currentPageData;
+            currentPageNum = rightSibPageNo;
+            currentPage = bufMgr -> readPage(file, currentPageNum);
+            currNode = (LeafNodeInt*) currentPage.get();
             nextEntry = 0;
         }
         int key = currNode -> keyArray[nextEntry];
@@ -274,7 +293,7 @@ namespace badgerdb
             // Key is not valid
         else
         {
-            bufMgr -> unPinPage(file, currentPageNum, false);
+            currentPage.release();
             throw IndexScanCompletedException();
         }
     }
@@ -291,7 +310,7 @@ namespace badgerdb
         }
         // reset vars
         scanExecuting = false;
-        currentPageData = nullptr;
+        currentPage.release();
         currentPageNum = -1;
         nextEntry = -1;
     }
@@ -305,12 +324,11 @@ namespace badgerdb
      */
     PageKeyPair<int>* BTreeIndex::insert(RIDKeyPair<int> pair, PageId currNum, int isLeaf)
     {
-        Page* currPage;
-        bufMgr -> readPage(file, currNum, currPage);
+        PageHandle currPage = bufMgr -> readPage(file, currNum);
         // Current node is not leaf
         if (isLeaf == 0)
         {
-            NonLeafNodeInt* nonLeaf = (NonLeafNodeInt*) currPage;
+            NonLeafNodeInt* nonLeaf = (NonLeafNodeInt*) currPage.get();
             PageKeyPair<int>* pagePairTmp = nullptr;
             // find the child node to insert
             for (int i = 0; i < INTARRAYNONLEAFSIZE; i++)
@@ -351,44 +369,39 @@ namespace badgerdb
             if (pagePairTmp != nullptr)
             {
                 // if current node has space
+                currPage.markDirty();
                 if (nonLeaf -> pageNoArray[INTARRAYNONLEAFSIZE] == 0)
                 {
                     insertNonLeaf(*pagePairTmp, *pagePairTmp, nonLeaf);
-                    bufMgr -> unPinPage(file, currNum, true);
                     return nullptr;
                 }
                 // if current node has no space
                 else
                 {
-                    PageKeyPair<int>* moveUpMidPair = splitNonLeaf(currNum, nonLeaf, *pagePairTmp);
-                    bufMgr -> unPinPage(file, currNum, true);
-                    return moveUpMidPair;
+                    return splitNonLeaf(currNum, nonLeaf, *pagePairTmp);
                 }
             }
             else
             {
-                bufMgr -> unPinPage(file, currNum, true);
                 return nullptr;
             }
         }
         // if current node is leaf
         else
         {
-            LeafNodeInt* leafNode = (LeafNodeInt*) currPage;
+            LeafNodeInt* leafNode = (LeafNodeInt*) currPage.get();
+            currPage.markDirty();
             // if current node has space
             if (leafNode -> ridArray[INTARRAYLEAFSIZE - 1].slot_number == 0)
             {
                 insertLeaf(pair, leafNode);
-                bufMgr -> unPinPage(file, currNum, true);
                 return nullptr;
             }
             // if current node has no space
             else
             {
                 // split
-                PageKeyPair<int>* moveUpMidPair = splitLeaf(leafNode, currNum, pair);
-                bufMgr -> unPinPage(file, currNum, true);
-                return moveUpMidPair;
+                return splitLeaf(leafNode, currNum, pair);
             }
         }
     }
@@ -479,10 +492,10 @@ namespace badgerdb
     PageKeyPair<int>* BTreeIndex::splitLeaf(LeafNodeInt *leafNode, PageId currNum, RIDKeyPair<int> pair)
     {
         // create a new leaf
-        Page* newSibling;
         PageId newSiblingNum;
-        bufMgr -> allocPage(file, newSiblingNum, newSibling);
-        LeafNodeInt* siblingNode = (LeafNodeInt*) newSibling;
+        PageHandle newSibling = bufMgr -> allocPage(file, newSiblingNum);
+        newSibling.markDirty();
+        LeafNodeInt* siblingNode = (LeafNodeInt*) newSibling.get();
         // add rightSibPageNo to the current leaf node
         if (leafNode -> rightSibPageNo != 0)
         {
@@ -514,7 +527,8 @@ namespace badgerdb
         PageKeyPair<int>* rightPair = new PageKeyPair<int>;
         leftPair -> set(currNum, siblingNode -> keyArray[0]);
         rightPair -> set(newSiblingNum, siblingNode -> keyArray[0]);
-        return moveUpPair(leftPair, rightPair, 1, newSiblingNum, currNum);
+        newSibling.release();
+        return moveUpPair(leftPair, rightPair, 1, currNum);
     }
     /**
      * Split non-leaf node
@@ -527,10 +541,10 @@ namespace badgerdb
     PageKeyPair<int>* BTreeIndex::splitNonLeaf(PageId currNum, NonLeafNodeInt *nonLeafNode, PageKeyPair<int> pair)
     {
         // create a new non-leaf node
-        Page* newSibling;
         PageId newSiblingNum;
-        bufMgr -> allocPage(file, newSiblingNum, newSibling);
-        NonLeafNodeInt* siblingNode = (NonLeafNodeInt*) newSibling;
+        PageHandle newSibling = bufMgr -> allocPage(file, newSiblingNum);
+        newSibling.markDirty();
+        NonLeafNodeInt* siblingNode = (NonLeafNodeInt*) newSibling.get();
         siblingNode -> level = nonLeafNode -> level;
         // split the current non-leaf node to two non-leaf nodes
         for (int i = 0; i < INTARRAYNONLEAFSIZE / 2; i++)
@@ -559,7 +573,8 @@ namespace badgerdb
         PageKeyPair<int>* rightPair = new PageKeyPair<int>;
         leftPair -> set(currNum, midKey);
         rightPair -> set(newSiblingNum, midKey);
-        return moveUpPair(leftPair, rightPair, 0, newSiblingNum, currNum);
+        newSibling.release();
+        return moveUpPair(leftPair, rightPair, 0, currNum);
     }
     /**
      * Get the key that need to be moved up
@@ -567,31 +582,28 @@ namespace badgerdb
      * @param leftPair the pair of left node
      * @param rightPair the pair of right node
      * @param level the level of node to be set
-     * @param newSiblingNum the page number of new sibling node
      * @param currNum current page number
      * @return PageKeyPair<int>*
      */
     PageKeyPair<int>* BTreeIndex::moveUpPair(PageKeyPair<int>* leftPair, PageKeyPair<int>* rightPair,
-                                                            int level, PageId newSiblingNum, PageId currNum)
+                                                            int level, PageId currNum)
     {
         if (currNum == rootPageNum)
         {
-            Page* newRoot;
             PageId newRootNum;
-            bufMgr -> allocPage(file, newRootNum, newRoot);
-            NonLeafNodeInt* newRootNode = (NonLeafNodeInt*) newRoot;
+            PageHandle newRoot = bufMgr -> allocPage(file, newRootNum);
+            newRoot.markDirty();
+            NonLeafNodeInt* newRootNode = (NonLeafNodeInt*) newRoot.get();
             newRootNode -> level = level;
             // insert the key of the new leaves to the new root
             insertNonLeaf(*leftPair, *rightPair, newRootNode);
-            bufMgr -> unPinPage(file, newRootNum, true);
-            bufMgr -> unPinPage(file, newSiblingNum, true);
+            newRoot.release();
             changeRootNum(newRootNum);
             return nullptr;
         }
         // non-root node need to be split, then return the mid key directly to the upper level
         else
         {
-            bufMgr -> unPinPage(file, newSiblingNum, true);
             return rightPair;
         }
     }
@@ -603,11 +615,11 @@ namespace badgerdb
     const void BTreeIndex::changeRootNum(PageId newRootNum)
     {
         rootPageNum = newRootNum;
-        Page* headerPage;
-        bufMgr -> readPage(file, headerPageNum, headerPage);
-        IndexMetaInfo* headerNode = (IndexMetaInfo*)headerPage;
+        PageHandle headerPage = bufMgr -> readPage(file, headerPageNum);
+        // latch the page before changing it, so that no optimistic reader sees a half written header
+        headerPage.markDirty();
+        IndexMetaInfo* headerNode = (IndexMetaInfo*)headerPage.get();
         headerNode -> rootPageNo = newRootNum;
-        bufMgr -> unPinPage(file, headerPageNum, true);
     }
     /**
      * check if a node is non_leaf node
@@ -618,12 +630,9 @@ namespace badgerdb
      */
     const bool BTreeIndex::checkNonLeaf(NonLeafNodeInt *nonLeafNode, int index)
     {
-        Page* page;
-        bufMgr->readPage(file,nonLeafNode -> pageNoArray[index],page);
-        NonLeafNodeInt* p = (NonLeafNodeInt*) page;
-        bool findKey = findLeafNode(p, p->level);
-        bufMgr -> unPinPage(file, nonLeafNode -> pageNoArray[index], false);
-        return findKey;
+        PageHandle page = bufMgr -> readPage(file, nonLeafNode -> pageNoArray[index]);
+        NonLeafNodeInt* p = (NonLeafNodeInt*) page.get();
+        return findLeafNode(p, p->level);
     }
     /**
      * check if node is leaf
@@ -634,12 +643,9 @@ namespace badgerdb
      */
     const bool BTreeIndex::checkLeaf(NonLeafNodeInt *nonLeafNode, int index)
     {
-        Page* page;
-        bufMgr->readPage(file,nonLeafNode -> pageNoArray[index],page);
-        LeafNodeInt* p = (LeafNodeInt*) page;
-        bool findKey = searchKeyInLeaf(p, nonLeafNode->pageNoArray[index]);
-        bufMgr -> unPinPage(file, nonLeafNode -> pageNoArray[index], false);
-        return findKey;
+        PageHandle page = bufMgr -> readPage(file, nonLeafNode -> pageNoArray[index]);
+        LeafNodeInt* p = (LeafNodeInt*) page.get();
+        return searchKeyInLeaf(p, nonLeafNode->pageNoArray[index]);
     }
     /**
      * find leaf node
@@ -650,67 +656,80 @@ namespace badgerdb
      */
     const bool BTreeIndex::findLeafNode(NonLeafNodeInt *nonLeafNode, int nextNodeIsLeaf)
     {
+        int index = findChildIndex(nonLeafNode);
+        if (index < 0)
+        {
+            return false;
+        }
         // the next node is a nonLeafNode
         if (nextNodeIsLeaf == 0)
         {
-            for (int i = 0; i < INTARRAYNONLEAFSIZE - 1;i++)
-            {
-                if (i < INTARRAYNONLEAFSIZE - 1)
-                {
-                    if (i == 0 && nonLeafNode -> keyArray[i] > lowValInt)
-                    {
-                        return checkNonLeaf(nonLeafNode, i);
-                    }
-                    else if (nonLeafNode -> keyArray[i] <= lowValInt && lowValInt < nonLeafNode -> keyArray[i + 1])
-                    {
-                        return checkNonLeaf(nonLeafNode, i + 1);
-                    }
-                    else if (nonLeafNode -> keyArray[i + 1] == 0 && nonLeafNode -> keyArray[i] <= lowValInt)
-                    {
-                        return checkNonLeaf(nonLeafNode, i + 1);
-                    }
-                }
-                // i == INTARRAYNONLEAFSIZE - 1
-                else
-                {
-                    // insert key >= the last key
-                    if (nonLeafNode -> keyArray[i] <= lowValInt)
-                    {
-                        return checkNonLeaf(nonLeafNode, i + 1);
-                    }
-                }
-            }
+            return checkNonLeaf(nonLeafNode, index);
         }
         // the next node is leafnode
         else if (nextNodeIsLeaf == 1)
         {
-            for(int i = 0; i < INTARRAYNONLEAFSIZE - 1;i++)
+            return checkLeaf(nonLeafNode, index);
+        }
+        return false;
+    }
+    /**
+     * find the child which may hold lowValInt
+     *
+     * @param nonLeafNode
+     * @return index of the child, -1 if there is none
+     */
+    const int BTreeIndex::findChildIndex(const NonLeafNodeInt *nonLeafNode)
+    {
+        for (int i = 0; i < INTARRAYNONLEAFSIZE - 1; i++)
+        {
+            if (i == 0 && nonLeafNode -> keyArray[i] > lowValInt)
             {
-                if (i < INTARRAYNONLEAFSIZE - 1)
-                {
-                    if( i == 0 && nonLeafNode -> keyArray[i] > lowValInt)
-                    {
-                        return checkLeaf(nonLeafNode, i);
-                    }
-                    else if (nonLeafNode -> keyArray[i] <= lowValInt && lowValInt < nonLeafNode -> keyArray[i + 1])
-                    {
-                        return checkLeaf(nonLeafNode, i + 1);
-                    }
-                    else if (nonLeafNode -> keyArray[i + 1] == 0 && nonLeafNode -> keyArray[i] <= lowValInt)
-                    {
-                        return checkLeaf(nonLeafNode, i + 1);
-                    }
-                }
-                else
-                {
-                    if (nonLeafNode -> keyArray[i] <= lowValInt)
-                    {
-                        return checkLeaf(nonLeafNode, i + 1);
-                    }
-                }
+                return i;
+            }
+            else if (nonLeafNode -> keyArray[i] <= lowValInt && lowValInt < nonLeafNode -> keyArray[i + 1])
+            {
+                return i + 1;
+            }
+            else if (nonLeafNode -> keyArray[i + 1] == 0 && nonLeafNode -> keyArray[i] <= lowValInt)
+            {
+                return i + 1;
             }
         }
-        return false;
+        return -1;
+    }
+    /**
+     * find the leaf which may hold lowValInt, reading the non leaf nodes optimistically
+     *
+     * @param leafPageNum
+     * @return bool if the leaf was found
+     */
+    const bool BTreeIndex::findLeafOptimistic(PageId& leafPageNum)
+    {
+        PageId pageNum = rootPageNum;
+        while (true)
+        {
+            OptimisticRead read;
+            if (!bufMgr -> readOptimistic(file, pageNum, read))
+            {
+                return false;
+            }
+            // copy out what is needed before validating, the node may change at any time
+            const NonLeafNodeInt* node = (const NonLeafNodeInt*) read.page;
+            int level = node -> level;
+            int index = findChildIndex(node);
+            PageId childNum = index < 0 ? 0 : node -> pageNoArray[index];
+            if (!bufMgr -> validate(read) || index < 0)
+            {
+                return false;
+            }
+            if (level == 1)
+            {
+                leafPageNum = childNum;
+                return true;
+            }
+            pageNum = childNum;
+        }
     }
     /**
      * Check if the key is valid
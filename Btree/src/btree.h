@@ -247,9 +247,9 @@ class BTreeIndex {
 	PageId	currentPageNum;
 
   /**
-   * Current Page being scanned.
+   * Handle pinning the current Page being scanned.
    */
-	Page		*currentPageData;
+	PageHandle	currentPage;
 
   /**
    * Low INTEGER value for scan.
@@ -343,14 +343,13 @@ class BTreeIndex {
      * @param leftPair       a pointer to a pair of page number and key which might be moved up
      * @param rightPair      a pointer to a pair of page number and key which might be moved up
      * @param level          the level of current node to be splitted
-     * @param newSiblingNum  the page number of the right sibling of the current node to be splitted
      * @param currNum        the page number of the current node to be splitted
      * @return PageKeyPair<int>* a pointer to a pair of page number and key
      *                           returns null if a new root is created
      *                           Otherwise returns a pair of page and key which needs to be moved up
      */
     PageKeyPair<int>* moveUpPair(PageKeyPair<int>* leftPair, PageKeyPair<int>* rightPair,
-                                            int level, PageId newSiblingNum, PageId currNum);
+                                            int level, PageId currNum);
     /**
      * This method is used to recursively find if lowIntVal is within the range of a leaf node
      * @param nonLeafNode    the pointer to the non leaf node struct
@@ -359,6 +358,21 @@ class BTreeIndex {
      *              Otherwise, return false
      */
     const bool findLeafNode(NonLeafNodeInt *nonLeafNode, int nextNodeIsLeaf);
+    /**
+     * This method is used to find which child of a non leaf node may hold lowIntVal
+     * @param nonLeafNode a pointer to a non leaf node struct
+     * @return int the index of the child in pageNoArray, or -1 if no child may hold lowIntVal
+     */
+    const int findChildIndex(const NonLeafNodeInt *nonLeafNode);
+    /**
+     * This method is used to find the leaf which may hold lowIntVal without pinning the non leaf nodes on the way.
+     * Every node is read optimistically and validated before its child is followed.
+     * @param leafPageNum the page number of the leaf is returned via this reference
+     * @return bool returns true if the leaf was found,
+     *              false if a node was not in the buffer pool or changed while it was read,
+     *              or if no child may hold lowIntVal; the caller then descends with pinned pages
+     */
+    const bool findLeafOptimistic(PageId& leafPageNum);
     /**
      * This method is used to check which leaf need to be searched for lowIntVal
      * @param nonLeafNode a pointer to a non leaf node struct
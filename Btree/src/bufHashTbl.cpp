@@ -15,12 +15,12 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+int BufHashTbl::hash(const FileId fileId, const PageId pageNo)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
-  return value;
+  // the file id is small and dense, unlike the address of the file object,
+  // so spread files apart by a large odd multiplier
+  std::uint32_t tmp = fileId * 2654435761u + pageNo;
+  return tmp % (std::uint32_t) HTSIZE;
 }
 
 BufHashTbl::BufHashTbl(int htSize)
@@ -47,11 +47,12 @@ BufHashTbl::~BufHashTbl()
 
 void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
+  const FileId fileId = file->id();
+  int index = hash(fileId, pageNo);
 
   hashBucket* tmpBuc = ht[index];
   while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+    if (tmpBuc->fileId == fileId && tmpBuc->file == file && tmpBuc->pageNo == pageNo)
   		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
     tmpBuc = tmpBuc->next;
   }
@@ -61,6 +62,7 @@ void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId fra
   	throw HashTableException();
 
   tmpBuc->file = (File*) file;
+  tmpBuc->fileId = fileId;
   tmpBuc->pageNo = pageNo;
   tmpBuc->frameNo = frameNo;
   tmpBuc->next = ht[index];
@@ -69,10 +71,11 @@ void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId fra
 
 void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
 {
-  int index = hash(file, pageNo);
+  const FileId fileId = file->id();
+  int index = hash(fileId, pageNo);
   hashBucket* tmpBuc = ht[index];
   while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+    if (tmpBuc->fileId == fileId && tmpBuc->file == file && tmpBuc->pageNo == pageNo)
     {
       frameNo = tmpBuc->frameNo; // return frameNo by reference
       return;
@@ -85,13 +88,14 @@ void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo)
 
 void BufHashTbl::remove(const File* file, const PageId pageNo) {
 
-  int index = hash(file, pageNo);
+  const FileId fileId = file->id();
+  int index = hash(fileId, pageNo);
   hashBucket* tmpBuc = ht[index];
   hashBucket* prevBuc = NULL;
 
   while (tmpBuc)
 	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+    if (tmpBuc->fileId == fileId && tmpBuc->file == file && tmpBuc->pageNo == pageNo)
 		{
       if(prevBuc) 
 				prevBuc->next = tmpBuc->next;
@@ -111,4 +115,27 @@ void BufHashTbl::remove(const File* file, const PageId pageNo) {
   throw HashNotFoundException(file->filename(), pageNo);
 }
 
+void BufHashTbl::rehash(const int htSize)
+{
+  hashBucket** oldHt = ht;
+  int oldSize = HTSIZE;
+
+  HTSIZE = htSize;
+  ht = new hashBucket* [htSize];
+  for(int i=0; i < HTSIZE; i++)
+    ht[i] = NULL;
+
+  // relink the existing buckets instead of allocating new ones
+  for(int i = 0; i < oldSize; i++) {
+    while (oldHt[i]) {
+      hashBucket* tmpBuc = oldHt[i];
+      oldHt[i] = tmpBuc->next;
+      int index = hash(tmpBuc->fileId, tmpBuc->pageNo);
+      tmpBuc->next = ht[index];
+      ht[index] = tmpBuc;
+    }
+  }
+  delete [] oldHt;
+}
+
 }
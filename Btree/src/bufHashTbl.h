@@ -20,6 +20,11 @@ struct hashBucket {
 	 */
 	File *file;
 
+	/**
+	 * id the file had when the entry was inserted, which the entry is hashed and looked up by
+	 */
+	FileId fileId;
+
 	/**
 	 * page number within a file
 	 */
@@ -40,6 +45,9 @@ struct hashBucket {
 /**
 * @brief Hash table class to keep track of pages in the buffer pool
 *
+* Entries are keyed by the file object, its id and the page number, and hashed by the id and page number. The id
+* is kept in the entry, so rehashing does not depend on the file object still having it.
+*
 * @warning This class is not threadsafe.
 */
 class BufHashTbl
@@ -55,13 +63,13 @@ class BufHashTbl
   hashBucket**  ht;
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * returns hash value between 0 and HTSIZE-1 computed using the id of file and pageNo
 	 *
-	 * @param file   	File object
+	 * @param fileId 	Id of the file
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  int	 hash(const FileId fileId, const PageId pageNo);
 
  public:
 	/**
@@ -104,6 +112,13 @@ class BufHashTbl
    * @throws HashNotFoundException if the page entry is not found in the hash table 
 	 */
   void remove(const File* file, const PageId pageNo);  
+
+	/**
+   * Changes the number of buckets, moving every entry to its bucket in the new table.
+	 *
+	 * @param htSize  New size of hash table
+	 */
+  void rehash(const int htSize);
 };
 
 }
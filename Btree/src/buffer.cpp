@@ -7,33 +7,76 @@
 
 #include <memory>
 #include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <fstream>
+#include <algorithm>
+#include <cstdio>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/file_open_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/insufficient_space_exception.h"
 
 namespace badgerdb { 
 
+// Pins a thread holds on frames of a buffer manager, for the generation of the frame they were taken in. Slots with
+// a zero managerId are free.
+struct LocalPin
+{
+  std::uint64_t managerId;
+  FrameId frameNo;
+  std::uint64_t generation;
+  std::uint32_t count;
+};
+
+static const int NUM_LOCAL_PINS = 8;
+static thread_local LocalPin localPins[NUM_LOCAL_PINS];
+
+// Id of the next buffer manager created; zero marks free local pin slots
+static std::atomic<std::uint64_t> nextManagerId(1);
+
 //----------------------------------------
 // Constructor of the class BufMgr
 //----------------------------------------
 
 BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
+	: numBufs(bufs), useClock(0), readaheadEnabled(true), compressedCache(0), victimCache(NULL) {
 	bufDescTable = new BufDesc[bufs];
+  managerId = nextManagerId.fetch_add(1);
+  generationClock = 0;
 
   for (FrameId i = 0; i < bufs; i++) 
   {
   	bufDescTable[i].frameNo = i;
-  	bufDescTable[i].valid = false;
+  	bufDescTable[i].generation = ++generationClock;
   }
+  validBits.resize(bufs);
+  refBits.resize(bufs);
+  pinnedBits.resize(bufs);
+  dirtyBits.resize(bufs);
+
+  // every frame is allocated on its own so that resizing the pool never moves a pinned page
+  bufPool.resize(bufs);
+  for (FrameId i = 0; i < bufs; i++)
+  	bufPool[i] = new Page;
+
+  // all frames start out free, handed out from frame 0 up
+  for (FrameId i = bufs; i > 0; i--)
+  	freeFrames.push_back(i - 1);
 
-  bufPool = new Page[bufs];
+  hashTable = new BufHashTbl (hashTableSize(bufs));  // allocate the buffer hash table
 
-  int htsize = ((((int) (bufs * 1.2))*2)/2)+1;
-  hashTable = new BufHashTbl (htsize);  // allocate the buffer hash table
+  frameVersions = new std::atomic<std::uint64_t>[bufs];
+  for (FrameId i = 0; i < bufs; i++)
+  	frameVersions[i].store(0, std::memory_order_relaxed);
+
+  ioEngine = IoEngine::create(IO_QUEUE_DEPTH);
 
   clockHand = bufs - 1;
 }
@@ -41,115 +84,801 @@ BufMgr::BufMgr(std::uint32_t bufs)
 
 BufMgr::~BufMgr() {
   //Flush out all unwritten pages
+  std::vector<FrameId> dirtyFrames;
   for (std::uint32_t i = 0; i < numBufs; i++) 
   {
-  	BufDesc* tmpbuf = &bufDescTable[i];
-  	if (tmpbuf->valid == true && tmpbuf->dirty == true)
+  	if (validBits.test(i) && dirtyBits.test(i))
 		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+			dirtyFrames.push_back(i);
+  	}
+  }
+  sortFrames(dirtyFrames.data(), dirtyFrames.size());
+  writeFrames(dirtyFrames.data(), dirtyFrames.size());
+  delete ioEngine;
+
+  // give back this thread's slots; a later manager has another id, so it would not match them anyway
+  for (int i = 0; i < NUM_LOCAL_PINS; i++)
+  {
+    if (localPins[i].managerId == managerId)
+      localPins[i].managerId = 0;
+  }
+
+  delete [] bufDescTable;
+  for (std::uint32_t i = 0; i < numBufs; i++)
+  	delete bufPool[i];
+  delete hashTable;
+  delete [] frameVersions;
+  delete victimCache;
+}
+
+void BufMgr::setVictimCache(const std::string& path, const std::uint32_t pages)
+{
+  delete victimCache;
+  victimCache = NULL;
+  if (pages > 0)
+    victimCache = new VictimCache(path, pages);
+}
+
+int BufMgr::hashTableSize(std::uint32_t bufs)
+{
+  return ((((int) (bufs * 1.2))*2)/2)+1;
+}
+
+void BufMgr::resize(std::uint32_t newBufs)
+{
+  if (newBufs == 0)
+  	throw BufferExceededException();
+
+  if (newBufs < numBufs)
+  {
+  	// a pinned page cannot be moved to another frame, so give up before touching anything
+  	// if any of the frames to be removed is still pinned
+  	for (std::uint32_t i = newBufs; i < numBufs; i++)
+  	{
+  		BufDesc* tmpbuf = &bufDescTable[i];
+  		if (validBits.test(i) && tmpbuf->pinCnt > 0)
+  			throw PagePinnedException(tmpbuf->file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
+  	}
+
+  	// evict the pages held in the tail frames
+  	for (std::uint32_t i = newBufs; i < numBufs; i++)
+  	{
+  		BufDesc* tmpbuf = &bufDescTable[i];
+  		if (validBits.test(i))
+  		{
+  			if (dirtyBits.test(i))
+  			{
+  				writeFrame(i);
+  			}
+  			hashTable->remove(tmpbuf->file, tmpbuf->pageNo);
+  			clearFrame(i);
+  		}
+  		delete bufPool[i];
   	}
+  	bufPool.resize(newBufs);
+
+  	std::vector<FrameId> keptFrames;
+  	for (std::size_t i = 0; i < freeFrames.size(); i++)
+  	{
+  		if (freeFrames[i] < newBufs)
+  			keptFrames.push_back(freeFrames[i]);
+  	}
+  	freeFrames.swap(keptFrames);
+  }
+  else
+  {
+  	bufPool.resize(newBufs);
+  	for (std::uint32_t i = numBufs; i < newBufs; i++)
+  		bufPool[i] = new Page;
+  	for (std::uint32_t i = newBufs; i > numBufs; i--)
+  		freeFrames.push_back(i - 1);
   }
 
+  // descriptors of the frames that are kept do not change
+  BufDesc* newDescTable = new BufDesc[newBufs];
+  for (std::uint32_t i = 0; i < newBufs; i++)
+  {
+  	if (i < numBufs)
+  		newDescTable[i] = bufDescTable[i];
+  	else
+  		newDescTable[i].generation = ++generationClock;
+  	newDescTable[i].frameNo = i;
+  }
   delete [] bufDescTable;
-  delete [] bufPool;
+  bufDescTable = newDescTable;
+  validBits.resize(newBufs);
+  refBits.resize(newBufs);
+  pinnedBits.resize(newBufs);
+  dirtyBits.resize(newBufs);
+
+  // frames that are removed take their versions with them, so the pool must not be read optimistically while it
+  // is resized
+  std::atomic<std::uint64_t>* newVersions = new std::atomic<std::uint64_t>[newBufs];
+  for (std::uint32_t i = 0; i < newBufs; i++)
+  	newVersions[i].store(i < numBufs ? frameVersions[i].load(std::memory_order_relaxed) : 0, std::memory_order_relaxed);
+  delete [] frameVersions;
+  frameVersions = newVersions;
+
+  numBufs = newBufs;
+  if (clockHand >= numBufs)
+  	clockHand = numBufs - 1;
+
+  hashTable->rehash(hashTableSize(numBufs));
 }
 
-void BufMgr::allocBuf(FrameId & frame) 
+void BufMgr::setFileQuota(const std::string& filename, std::uint32_t minFrames, std::uint32_t maxFrames)
 {
+  std::map<std::string, BufQuota>::iterator it = fileQuotas.find(filename);
+  if (it != fileQuotas.end())
+  {
+  	it->second.minFrames = minFrames;
+  	it->second.maxFrames = maxFrames;
+  	return;
+  }
+
+  // the slots of the file would still say it has no quota
+  fileSlots.clear();
+  BufQuota* quota = &fileQuotas[filename];
+  quota->minFrames = minFrames;
+  quota->maxFrames = maxFrames;
+  quota->resident = 0;
+
+  // pages of the file already in the pool now count against its partition
+  for (std::uint32_t i = 0; i < numBufs; i++)
+  {
+  	BufDesc* tmpbuf = &bufDescTable[i];
+  	if (validBits.test(i) && tmpbuf->file->filename() == filename)
+  	{
+  		tmpbuf->quota = quota;
+  		quota->resident++;
+  	}
+  }
+}
+
+void BufMgr::clearFileQuota(const std::string& filename)
+{
+  std::map<std::string, BufQuota>::iterator it = fileQuotas.find(filename);
+  if (it == fileQuotas.end())
+  	return;
+
+  for (std::uint32_t i = 0; i < numBufs; i++)
+  {
+  	if (bufDescTable[i].quota == &it->second)
+  		bufDescTable[i].quota = NULL;
+  }
+  fileSlots.clear();
+  fileQuotas.erase(it);
+}
+
+BufQuota BufMgr::getFileQuota(const std::string& filename) const
+{
+  std::map<std::string, BufQuota>::const_iterator it = fileQuotas.find(filename);
+  if (it == fileQuotas.end())
+  {
+  	BufQuota none = {0, 0, 0};
+  	return none;
+  }
+  return it->second;
+}
+
+const BufFileSlot& BufMgr::lookupFile(const File* file)
+{
+  const FileId id = file->id();
+  if (id >= fileSlots.size())
+  {
+  	BufFileSlot empty = {NULL, NULL, NULL, NULL};
+  	fileSlots.resize(id + 1, empty);
+  }
+
+  BufFileSlot& slot = fileSlots[id];
+  if (slot.name != NULL && *slot.name == file->filename())
+  	return slot;
+
+  // the id is new to this pool, or was given to another file since
+  std::map<std::string, BufFileStats>::iterator stats = fileStats.find(file->filename());
+  if (stats == fileStats.end())
+  {
+  	BufFileStats empty = {0, 0, 0, 0};
+  	stats = fileStats.insert(std::make_pair(file->filename(), empty)).first;
+  }
+  std::map<std::string, BufQuota>::iterator quota = fileQuotas.find(file->filename());
+
+  slot.name = &stats->first;
+  slot.quota = quota == fileQuotas.end() ? NULL : &quota->second;
+  slot.stats = &stats->second;
+  // the map value-initializes new entries, so a file starts without a run
+  slot.readahead = &readaheads[file->filename()];
+  return slot;
+}
+
+void BufMgr::writeFrame(const FrameId frameNo)
+{
+  BufDesc* tmpbuf = &bufDescTable[frameNo];
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  tmpbuf->file->writePage(tmpbuf->pageNo, *bufPool[frameNo]);
+  writeLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+  		std::chrono::steady_clock::now() - start).count());
+
+  bufStats.diskwrites++;
+  if (tmpbuf->fileStats != NULL)
+  	tmpbuf->fileStats->diskwrites++;
+  unsyncedFiles.insert(tmpbuf->file->filename());
+}
+
+void BufMgr::sortFrames(FrameId* frames, const std::size_t count) const
+{
+  std::sort(frames, frames + count, [this](const FrameId a, const FrameId b) {
+    if (bufDescTable[a].file != bufDescTable[b].file)
+      return bufDescTable[a].file < bufDescTable[b].file;
+    return bufDescTable[a].pageNo < bufDescTable[b].pageNo;
+  });
+}
+
+void BufMgr::writeFrames(const FrameId* frames, const std::size_t count)
+{
+  std::size_t first = 0;
+  while (first < count)
+  {
+    // the frames of one file go to the engine as one batch
+    File* file = bufDescTable[frames[first]].file;
+    std::vector<PageId> pageNos;
+    std::vector<const Page*> pages;
+    std::size_t end = first;
+    for (; end < count && bufDescTable[frames[end]].file == file; end++)
+    {
+      pageNos.push_back(bufDescTable[frames[end]].pageNo);
+      pages.push_back(bufPool[frames[end]]);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    file->writePages(*ioEngine, pageNos.data(), pages.data(), pages.size());
+    unsyncedFiles.insert(file->filename());
+    const std::uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    		std::chrono::steady_clock::now() - start).count();
+
+    // the pages of a batch are written together, so the batch is one sample
+    writeLatency.record(elapsed);
+    for (std::size_t i = first; i < end; i++)
+    {
+      bufStats.diskwrites++;
+      if (bufDescTable[frames[i]].fileStats != NULL)
+      	bufDescTable[frames[i]].fileStats->diskwrites++;
+    }
+    first = end;
+  }
+}
+
+// Returns the bits of frames 'from' up to, but not including, 'to' within the word holding frame 'from'.
+// 'to' must not lie past the end of that word.
+static std::uint64_t maskFrom(const FrameId from, const FrameId to)
+{
+  const std::uint32_t count = to - from;
+  if (count == 0)
+    return 0;
+  const std::uint64_t bits = count == FrameBits::BITS_PER_WORD ? ~((std::uint64_t) 0) : (((std::uint64_t) 1) << count) - 1;
+  return bits << (from % FrameBits::BITS_PER_WORD);
+}
+
+void BufMgr::allocBuf(FrameId & frame, BufQuota* quota) 
+{
+  // a file at its cap may only replace its own pages
+  const bool capped = quota != NULL && quota->maxFrames > 0 && quota->resident >= quota->maxFrames;
+
+  // frames freed earlier are handed out without sweeping
+  if (!capped && !freeFrames.empty())
+  {
+    frame = freeFrames.back();
+    freeFrames.pop_back();
+    return;
+  }
+
   // perform first part of clock algorithm to search for 
   // open buffer frame
   // Assumes non-concurrent access to buffer manager
+  // Large pools evict several frames per sweep so that following calls find free frames
+  std::uint32_t batch = 1;
+  if (!capped)
+  {
+    batch = numBufs / 16;
+    if (batch < 1)
+      batch = 1;
+    else if (batch > MAX_EVICTION_BATCH)
+      batch = MAX_EVICTION_BATCH;
+  }
+  FrameId victims[MAX_EVICTION_BATCH];
+  std::uint32_t numVictims = 0;
   std::uint32_t numScanned = 0;
-  bool found = 0;
 
-  while (numScanned < 2*numBufs)	//Need to scn twice
+  while (numScanned < 2*numBufs && numVictims < batch)	//Need to scn twice
   {
     // advance the clock
     advanceClock();
-    numScanned++;
 
-    // if invalid, use frame
-    if (! bufDescTable[clockHand].valid)
-    {
-      break;
-    }
+    // look at the frames from the clock hand to the end of its word at once
+    const std::uint32_t wordNo = clockHand / FrameBits::BITS_PER_WORD;
+    std::uint32_t end = (wordNo + 1) * FrameBits::BITS_PER_WORD;
+    if (end > numBufs)
+      end = numBufs;
+    if (end - clockHand > 2*numBufs - numScanned)
+      end = clockHand + (2*numBufs - numScanned);
+    const std::uint64_t span = maskFrom(clockHand, end);
+
+    const std::uint64_t valid = validBits.word(wordNo);
+    const std::uint64_t ref = refBits.word(wordNo);
+    const std::uint64_t pinned = pinnedBits.word(wordNo);
 
-    // is valid, check referenced bit
-    if (! bufDescTable[clockHand].refbit)
+    // if invalid, use frame; if valid, not referenced and not pinned, it is a candidate victim
+    std::uint64_t candidates = valid & ~ref & ~pinned & span;
+    if (!capped)
+      candidates |= ~valid & span;
+
+    FrameId last = end - 1;
+    while (candidates != 0)
     {
-      // check to see if someone has it pinned
-      if (bufDescTable[clockHand].pinCnt == 0)
+      const FrameId candidate = wordNo * FrameBits::BITS_PER_WORD + __builtin_ctzll(candidates);
+      candidates &= candidates - 1;
+
+      // the second time round the clock comes across the victims already taken
+      if (std::find(victims, victims + numVictims, candidate) != victims + numVictims)
+        continue;
+
+      if (validBits.test(candidate))
+      {
+        // keep the pages of a capped file to itself and leave reserved partitions alone; victims beyond the one
+        // asked for are only taken from frames outside of any reservation
+        BufQuota* victimQuota = bufDescTable[candidate].quota;
+        if (capped ? victimQuota != quota
+                   : (victimQuota != NULL && victimQuota != quota && victimQuota->resident <= victimQuota->minFrames))
+        {
+          continue;
+        }
+        if (numVictims > 0 && victimQuota != NULL && victimQuota->minFrames > 0)
+          continue;
+      }
+      victims[numVictims++] = candidate;
+      if (numVictims == batch)
       {
-        // hasn't been referenced and is not pinned, use it
-        // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
-        found = true;
+        last = candidate;
         break;
       }
     }
-    else
-    {
-      // has been referenced, clear the bit
-      bufStats.accesses++;
-      bufDescTable[clockHand].refbit = false;
-    }
+
+    // frames passed over have been referenced, clear the bit, or are pinned
+    const std::uint64_t passed = maskFrom(clockHand, last + 1);
+    bufStats.pinWaits += __builtin_popcountll(valid & ~ref & pinned & passed);
+    refBits.word(wordNo) &= ~passed;
+
+    numScanned += last + 1 - clockHand;
+    clockHand = last;
   }
   
   // check for full buffer pool
-  if (!found && numScanned >= 2*numBufs)
+  if (numVictims == 0)
   {
     throw BufferExceededException();
   }
-  
+
+  // write back dirty victims in file and page order, so that they go to disk as one sorted batch
+  FrameId sorted[MAX_EVICTION_BATCH];
+  std::copy(victims, victims + numVictims, sorted);
+  sortFrames(sorted, numVictims);
+  FrameId dirty[MAX_EVICTION_BATCH];
+  std::uint32_t numDirty = 0;
+  for (std::uint32_t i = 0; i < numVictims; i++)
+  {
+    if (validBits.test(sorted[i]) && dirtyBits.test(sorted[i]))
+      dirty[numDirty++] = sorted[i];
+  }
+  writeFrames(dirty, numDirty);
+
+  // the victims stay findable until their pages are safely on disk; should the write fail, they are still in
+  // the pool, dirty, and nothing is lost
+  for (std::uint32_t i = 0; i < numVictims; i++)
+  {
+    if (validBits.test(sorted[i]))
+      hashTable->remove(bufDescTable[sorted[i]].file, bufDescTable[sorted[i]].pageNo);
+    evictFrame(sorted[i]);
+  }
+
+  // return new frame number, the other victims are free for the next calls
+  frame = victims[0];
+  for (std::uint32_t i = numVictims; i > 1; i--)
+    freeFrames.push_back(victims[i - 1]);
+} // end allocBuf
+
+void BufMgr::evictFrame(const FrameId frameNo)
+{
   // flush any existing changes to disk if necessary
-  if (bufDescTable[clockHand].dirty)
+  if (validBits.test(frameNo))
   {
-    bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    if (bufDescTable[frameNo].fileStats != NULL)
+      bufDescTable[frameNo].fileStats->evictions++;
+
+    // a page read ahead for nothing means the window of its file is too large
+    if (bufDescTable[frameNo].prefetched)
+    {
+      bufStats.wastedPrefetches++;
+      BufReadahead* ra = lookupFile(bufDescTable[frameNo].file).readahead;
+      if (ra->window > 1)
+        ra->window /= 2;
+    }
+
+    // dirty pages have been written back by the caller
+    if (dirtyBits.test(frameNo))
+      bufStats.dirtyEvictions++;
+    else
+      bufStats.cleanEvictions++;
+
+    // the page now matches the disk, so a compressed copy can stand in for it
+    if (compressedCache.getCapacity() > 0
+    		&& compressedCache.insert(bufDescTable[frameNo].file, bufDescTable[frameNo].pageNo, *bufPool[frameNo]))
+      bufStats.compressedStores++;
+    if (victimCache != NULL
+    		&& victimCache->insert(bufDescTable[frameNo].file, bufDescTable[frameNo].pageNo, *bufPool[frameNo]))
+      bufStats.victimStores++;
   }
 
 	//Reset all the BufDesc entry for the frame before returning the frame
-  bufDescTable[clockHand].Clear();
+  clearFrame(frameNo);
+}
 
-  // return new frame number
-  frame = clockHand;
-} // end allocBuf
+void BufMgr::setFrame(const FrameId frameNo, File* file, const PageId pageNo, BufQuota* quota, BufFileStats* stats)
+{
+  bufDescTable[frameNo].Set(file, pageNo, quota, stats);
+  if (quota != NULL)
+    quota->resident++;
+  validBits.set(frameNo);
+  refBits.set(frameNo);
+  dirtyBits.reset(frameNo);
+  pinFrame(frameNo);
+}
+
+void BufMgr::clearFrame(const FrameId frameNo)
+{
+  if (validBits.test(frameNo) && bufDescTable[frameNo].quota != NULL)
+    bufDescTable[frameNo].quota->resident--;
+
+  // pins of a page disposed of while pinned, by any thread, must not count for the next page in the frame
+  bufDescTable[frameNo].generation = ++generationClock;
+  bufDescTable[frameNo].Clear();
+  validBits.reset(frameNo);
+  refBits.reset(frameNo);
+  pinnedBits.reset(frameNo);
+  dirtyBits.reset(frameNo);
+}
 
 	
-void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+FrameId BufMgr::pinPage(File* file, const PageId pageNo)
 {
 
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
   FrameId frameNo = 0;
+  bool prefetchHit = false;
+  bufStats.accesses++;
 	try
 	{
   	hashTable->lookup(file, pageNo, frameNo);
 
-    // set the referenced bit
-    bufDescTable[frameNo].refbit = true;
-    bufDescTable[frameNo].pinCnt++;
-    page = &bufPool[frameNo];
+    // set the referenced bit, but only write it when it actually changes
+    if (!refBits.test(frameNo))
+      refBits.set(frameNo);
+    pinFrame(frameNo);
+
+    bufStats.hits++;
+    bufDescTable[frameNo].fileStats->hits++;
+
+    if (bufDescTable[frameNo].prefetched)
+    {
+      bufDescTable[frameNo].prefetched = false;
+      bufStats.prefetchHits++;
+      prefetchHit = true;
+    }
   }
   catch(HashNotFoundException e) //not in the buffer pool, must allocate a new page
   {
-    // alloc a new frame
-    allocBuf(frameNo);
+    frameNo = fetchPage(file, pageNo);
+    bufStats.misses++;
+    bufDescTable[frameNo].fileStats->misses++;
+  }
+  bufDescTable[frameNo].lastUsed = ++useClock;
+
+  if (readaheadEnabled)
+    readAhead(file, pageNo, prefetchHit);
+  return frameNo;
+}
+
+std::uint32_t BufMgr::maxReadaheadWindow() const
+{
+  std::uint32_t maxWindow = numBufs / 4;
+  if (maxWindow > 64)
+    maxWindow = 64;
+  return maxWindow;
+}
+
+void BufMgr::readAhead(File* file, const PageId pageNo, const bool prefetchHit)
+{
+  const BufFileSlot& slot = lookupFile(file);
+  BufReadahead& ra = *slot.readahead;
+  std::uint32_t maxWindow = maxReadaheadWindow();
+
+  // a capped file would only evict its own pages to make room for the pages read ahead
+  BufQuota* quota = slot.quota;
+  if (quota != NULL && quota->maxFrames > 0 && maxWindow > quota->maxFrames / 2)
+    maxWindow = quota->maxFrames / 2;
+
+  if (prefetchHit && ra.window < maxWindow)
+    ra.window = ra.window * 2 < maxWindow ? ra.window * 2 : maxWindow;
 
-    // read the page into the new frame
+  // the first page asked for only marks where a run may start
+  if (ra.lastPageNo == Page::INVALID_NUMBER)
+  {
+    ra.lastPageNo = pageNo;
+    return;
+  }
+
+  const std::int64_t delta = (std::int64_t) pageNo - (std::int64_t) ra.lastPageNo;
+  if (delta == 0)
+    return;
+  if (ra.runLength > 0 && delta == ra.stride)
+    ra.runLength++;
+  else
+  {
+    ra.stride = delta;
+    ra.runLength = 1;
+    ra.nextPrefetch = pageNo + delta;
+  }
+  ra.lastPageNo = pageNo;
+
+  // wait for the third page of a run, and leave wide jumps to chance rather than reading far away pages
+  if (ra.runLength < 2 || ra.stride > 64 || ra.stride < -64 || maxWindow == 0)
+    return;
+  if (ra.window == 0)
+    ra.window = 4;
+  if (ra.window > maxWindow)
+    ra.window = maxWindow;
+
+  // the pages up to nextPrefetch have been read already, unless the run was left behind
+  const std::int64_t direction = ra.stride > 0 ? 1 : -1;
+  std::int64_t next = ra.nextPrefetch;
+  if ((next - (std::int64_t) pageNo) * direction <= 0)
+    next = pageNo + ra.stride;
+  const std::int64_t last = pageNo + ra.stride * ra.window;
+
+  std::vector<PageId> pageNos;
+  for (; (last - next) * direction >= 0; next += ra.stride)
+  {
+    if (next <= Page::INVALID_NUMBER || next > (std::int64_t) UINT32_MAX)
+      break;
+
+    FrameId frameNo = 0;
+    try
+    {
+      hashTable->lookup(file, (PageId) next, frameNo);
+      continue;
+    }
+    catch(HashNotFoundException e)
+    {
+    }
+    pageNos.push_back((PageId) next);
+  }
+  ra.nextPrefetch = next;
+
+  bool poolFull;
+  const std::size_t numPrefetched = loadPages(file, pageNos, true /* readAhead */, poolFull);
+  if (numPrefetched < pageNos.size())
+    ra.nextPrefetch = pageNos[numPrefetched];
+}
+
+std::size_t BufMgr::loadPages(File* file, const std::vector<PageId>& pageNos, const bool readAhead, bool& poolFull)
+{
+  poolFull = false;
+  const BufFileSlot& slot = lookupFile(file);
+  BufQuota* quota = slot.quota;
+  BufFileStats* stats = slot.stats;
+
+  // set up a frame for every page first, pinned so that allocBuf does not hand it out again
+  std::vector<FrameId> frames;
+  std::vector<PageId> diskPageNos;
+  std::vector<FrameId> diskFrames;
+  std::vector<Page*> diskPages;
+  for (std::size_t i = 0; i < pageNos.size(); i++)
+  {
+    FrameId frameNo = 0;
+    try
+    {
+      allocBuf(frameNo, quota);
+    }
+    catch(BufferExceededException e)
+    {
+      poolFull = true;
+      break;
+    }
+    beginFrameChange(frameNo);
+    setFrame(frameNo, file, pageNos[i], quota, stats);
+    hashTable->insert(file, pageNos[i], frameNo);
+    frames.push_back(frameNo);
+
+    if (compressedCache.take(file, pageNos[i], *bufPool[frameNo]))
+      bufStats.compressedHits++;
+    else if (victimCache != NULL && victimCache->take(file, pageNos[i], *bufPool[frameNo]))
+      bufStats.victimHits++;
+    else
+    {
+      diskPageNos.push_back(pageNos[i]);
+      diskFrames.push_back(frameNo);
+      diskPages.push_back(bufPool[frameNo]);
+    }
+  }
+
+  // the rest come from disk as one batch
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  const std::size_t numRead = file->readPages(*ioEngine, diskPageNos.data(), diskPages.data(), diskPages.size());
+  const std::uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+  		std::chrono::steady_clock::now() - start).count();
+  if (numRead > 0)
+    readLatency.record(elapsed);
+  bufStats.diskreads += numRead;
+
+  // pages past the end of the file or deleted end the run for now; the frames set up for them, and for
+  // the pages after them, are given back
+  PageId firstMissing = 0;
+  bool missing = numRead < diskFrames.size();
+  if (missing)
+    firstMissing = diskPageNos[numRead];
+  for (std::size_t i = 0; i < frames.size(); i++)
+  {
+    const FrameId frameNo = frames[i];
+    if (missing && bufDescTable[frameNo].pageNo == firstMissing)
+    {
+      for (std::size_t j = i; j < frames.size(); j++)
+      {
+        hashTable->remove(file, bufDescTable[frames[j]].pageNo);
+        unPinFrame(frames[j], false);
+        clearFrame(frames[j]);
+        endFrameChange(frames[j]);
+        freeFrames.push_back(frames[j]);
+      }
+      poolFull = false;
+      return i;
+    }
+
+    // leave the page unpinned and unreferenced, so that it is the first to go if it is never used
+    endFrameChange(frameNo);
+    unpinLoadedFrame(frameNo);
+    if (readAhead)
+    {
+      bufDescTable[frameNo].prefetched = true;
+      bufStats.prefetches++;
+    }
+  }
+  return frames.size();
+}
+
+FrameId BufMgr::fetchPage(File* file, const PageId pageNo)
+{
+  // alloc a new frame
+  FrameId frameNo = 0;
+  const BufFileSlot& slot = lookupFile(file);
+  BufQuota* quota = slot.quota;
+  BufFileStats* stats = slot.stats;
+  allocBuf(frameNo, quota);
+
+  // read the page into the new frame
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  beginFrameChange(frameNo);
+  bool fromDisk = true;
+  if (compressedCache.take(file, pageNo, *bufPool[frameNo]))
+  {
+    bufStats.compressedHits++;
+    fromDisk = false;
+  }
+  else if (victimCache != NULL && victimCache->take(file, pageNo, *bufPool[frameNo]))
+  {
+    bufStats.victimHits++;
+    fromDisk = false;
+  }
+  if (fromDisk)
+  {
+    try
+    {
+      //status = file->readPage(pageNo, &bufPool[frameNo]);
+      file->readPage(pageNo, *bufPool[frameNo]);
+    }
+    catch(...)
+    {
+      endFrameChange(frameNo);
+      freeFrames.push_back(frameNo);
+      throw;
+    }
+  }
+  if (fromDisk)
+  {
+    readLatency.record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    		std::chrono::steady_clock::now() - start).count());
     bufStats.diskreads++;
-    //status = file->readPage(pageNo, &bufPool[frameNo]);
-    bufPool[frameNo] = file->readPage(pageNo);
-    // set up the entry properly
-    bufDescTable[frameNo].Set(file, pageNo);
-    page = &bufPool[frameNo];
+  }
+
+  // set up the entry properly, before optimistic readers can see the frame again
+  setFrame(frameNo, file, pageNo, quota, stats);
+  endFrameChange(frameNo);
+
+    // insert in the hash table
+  hashTable->insert(file, pageNo, frameNo);
+  return frameNo;
+}
+
+void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
+{
+  page = bufPool[pinPage(file, pageNo)];
+}
+
+PageHandle BufMgr::readPage(File* file, const PageId pageNo)
+{
+  FrameId frameNo = pinPage(file, pageNo);
+  return PageHandle(this, frameNo, pageNo, bufPool[frameNo]);
+}
+
+
+void BufMgr::pinFrame(const FrameId frameNo)
+{
+  const std::uint64_t generation = bufDescTable[frameNo].generation;
+  LocalPin* freeSlot = NULL;
+  for (int i = 0; i < NUM_LOCAL_PINS; i++)
+  {
+    if (localPins[i].managerId == managerId && localPins[i].frameNo == frameNo)
+    {
+      if (localPins[i].generation == generation)
+      {
+        localPins[i].count++;
+        return;
+      }
+      // left over from an earlier page in the frame
+      localPins[i].managerId = 0;
+    }
+    if (localPins[i].managerId == 0 && freeSlot == NULL)
+      freeSlot = &localPins[i];
+  }
 
-      // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+  // first pin of the frame by this thread
+  bufDescTable[frameNo].pinCnt++;
+  pinnedBits.set(frameNo);
+  if (freeSlot != NULL)
+  {
+    freeSlot->managerId = managerId;
+    freeSlot->frameNo = frameNo;
+    freeSlot->generation = generation;
+    freeSlot->count = 1;
   }
 }
 
+void BufMgr::unPinFrame(const FrameId frameNo, const bool dirty)
+{
+  if (dirty == true) dirtyBits.set(frameNo);
+
+  for (int i = 0; i < NUM_LOCAL_PINS; i++)
+  {
+    if (localPins[i].managerId == managerId && localPins[i].frameNo == frameNo
+        && localPins[i].generation == bufDescTable[frameNo].generation)
+    {
+      if (--localPins[i].count > 0)
+        return;
+      // the thread drops its last pin, so it no longer counts in the shared pin count
+      localPins[i].managerId = 0;
+      break;
+    }
+  }
+
+  // make sure the page is actually pinned
+  if (bufDescTable[frameNo].pinCnt == 0)
+  {
+  	throw PageNotPinnedException(bufDescTable[frameNo].file == NULL ? "" : bufDescTable[frameNo].file->filename(),
+  	                             bufDescTable[frameNo].pageNo, frameNo);
+  }
+  else if (--bufDescTable[frameNo].pinCnt == 0)
+  	pinnedBits.reset(frameNo);
+}
 
 void BufMgr::unPinPage(File* file, const PageId pageNo, 
 			     const bool dirty) 
@@ -158,50 +887,107 @@ void BufMgr::unPinPage(File* file, const PageId pageNo,
     // lookup in hashtable
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
-  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
-
-  // make sure the page is actually pinned
-  if (bufDescTable[frameNo].pinCnt == 0)
-  {
-  	throw PageNotPinnedException(file->filename(), pageNo, frameNo);
-  }
-  else bufDescTable[frameNo].pinCnt--;
+  unPinFrame(frameNo, dirty);
 }
 
 void BufMgr::flushFile(const File* file) 
 {
+  // check all frames of the file before writing any of them
+  std::vector<FrameId> frames;
+  std::vector<FrameId> dirtyFrames;
   for (std::uint32_t i = 0; i < numBufs; i++)
 	{
   	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->valid == true && tmpbuf->file == file)
+  	if(validBits.test(i) && tmpbuf->file == file)
 		{
 	    if (tmpbuf->pinCnt > 0)
   			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
 
-	    if (tmpbuf->dirty == true)
-			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
-    	}
-
-    	hashTable->remove(file,tmpbuf->pageNo);
-    	tmpbuf->Clear();
+	    frames.push_back(i);
+	    if (dirtyBits.test(i))
+				dirtyFrames.push_back(i);
   	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
-  		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
+		else if (!validBits.test(i) && tmpbuf->file == file)
+  		throw BadBufferException(tmpbuf->frameNo, dirtyBits.test(i), validBits.test(i), refBits.test(i));
   }
+
+  // the dirty pages go to disk as one batch in page order
+  sortFrames(dirtyFrames.data(), dirtyFrames.size());
+  writeFrames(dirtyFrames.data(), dirtyFrames.size());
+
+  for (std::size_t i = 0; i < frames.size(); i++)
+  {
+    hashTable->remove(file, bufDescTable[frames[i]].pageNo);
+    clearFrame(frames[i]);
+    freeFrames.push_back(frames[i]);
+  }
+
+  // the file may be closed after this, and a new file could get the same address
+  compressedCache.eraseFile(file);
+  if (victimCache != NULL)
+    victimCache->eraseFile(file);
+
+  // with all pages on disk the header can follow
+  file->flushHeader();
+  unsyncedFiles.insert(file->filename());
+}
+
+bool BufMgr::checkpoint()
+{
+  std::vector<FrameId> dirtyFrames;
+  std::vector<File*> files;
+  for (std::uint32_t i = 0; i < numBufs; i++)
+  {
+  	if (!validBits.test(i))
+  		continue;
+  	if (dirtyBits.test(i))
+  		dirtyFrames.push_back(i);
+  	if (std::find(files.begin(), files.end(), bufDescTable[i].file) == files.end())
+  		files.push_back(bufDescTable[i].file);
+  }
+
+  sortFrames(dirtyFrames.data(), dirtyFrames.size());
+  writeFrames(dirtyFrames.data(), dirtyFrames.size());
+  for (std::size_t i = 0; i < dirtyFrames.size(); i++)
+  	dirtyBits.reset(dirtyFrames[i]);
+
+  bool synced = true;
+  for (std::size_t i = 0; i < files.size(); i++)
+  {
+  	if (!files[i]->sync())
+  		synced = false;
+  	unsyncedFiles.erase(files[i]->filename());
+  }
+
+  // files written to earlier, whose pages have left the pool since, may have been closed meanwhile; files
+  // whose header changed, through the pool or not, need it written even if none of their pages is dirty
+  const std::vector<std::string> dirtyHeaders = File::dirtyHeaderFiles();
+  unsyncedFiles.insert(dirtyHeaders.begin(), dirtyHeaders.end());
+  for (std::set<std::string>::const_iterator it = unsyncedFiles.begin(); it != unsyncedFiles.end(); ++it)
+  {
+  	if (!File::syncFile(*it))
+  		synced = false;
+  }
+  unsyncedFiles.clear();
+  return synced;
 }
 
 void BufMgr::disposePage(File* file, const PageId pageNo) 
 {
 	//Deallocate from file altogether
+  compressedCache.erase(file, pageNo);
+  if (victimCache != NULL)
+    victimCache->erase(file, pageNo);
+
   //See if it is in the buffer pool
   FrameId frameNo = 0;
   hashTable->lookup(file, pageNo, frameNo);
 
-	// clear the page
-	bufDescTable[frameNo].Clear();
+	// clear the page, optimistic readers must not follow a link to it any more
+	beginFrameChange(frameNo);
+	clearFrame(frameNo);
+	endFrameChange(frameNo);
+	freeFrames.push_back(frameNo);
 
 	hashTable->remove(file, pageNo);
 
@@ -210,23 +996,83 @@ void BufMgr::disposePage(File* file, const PageId pageNo)
 }
 
 
-void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+FrameId BufMgr::pinNewPage(File* file, PageId &pageNo)
 {
   FrameId frameNo;
+  bufStats.accesses++;
 
   // alloc a new frame
-  allocBuf(frameNo);
+  const BufFileSlot& slot = lookupFile(file);
+  BufQuota* quota = slot.quota;
+  BufFileStats* stats = slot.stats;
+  allocBuf(frameNo, quota);
 
   // allocate a new page in the file
 	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
-  page = &bufPool[frameNo];
+  beginFrameChange(frameNo);
+  try
+  {
+    file->allocatePage(pageNo, *bufPool[frameNo]);
+    // the number may be one of a deleted page
+    compressedCache.erase(file, pageNo);
+    if (victimCache != NULL)
+      victimCache->erase(file, pageNo);
+  }
+  catch(...)
+  {
+    endFrameChange(frameNo);
+    freeFrames.push_back(frameNo);
+    throw;
+  }
+  bufStats.diskreads++;
 
-  // set up the entry properly
-  bufDescTable[frameNo].Set(file, pageNo);
+  // set up the entry properly, before optimistic readers can see the frame again
+  setFrame(frameNo, file, pageNo, quota, stats);
+  endFrameChange(frameNo);
+  bufDescTable[frameNo].lastUsed = ++useClock;
+  // files may not write a new page when allocating it, the frame holds the only copy
+  dirtyBits.set(frameNo);
 
   // insert in the hash table
   hashTable->insert(file, pageNo, frameNo);
+  return frameNo;
+}
+
+void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+{
+  page = bufPool[pinNewPage(file, pageNo)];
+}
+
+PageHandle BufMgr::allocPage(File* file, PageId &pageNo)
+{
+  FrameId frameNo = pinNewPage(file, pageNo);
+  return PageHandle(this, frameNo, pageNo, bufPool[frameNo]);
+}
+
+RecordId BufMgr::insertRecord(PageFile* file, const std::string& record)
+{
+  if (record.length() > Page::MAX_RECORD_SIZE)
+    throw InsufficientSpaceException(Page::INVALID_NUMBER, record.length(), Page::DATA_SIZE);
+
+  PageHandle page;
+  PageId pageNo;
+  for (pageNo = file->findPageWithSpace(record.length(), 1); pageNo != Page::INVALID_NUMBER;
+       pageNo = file->findPageWithSpace(record.length(), pageNo + 1))
+  {
+    page = readPage(file, pageNo);
+    if (page->hasSpaceForRecord(record))
+      break;
+    // the map was behind the page
+    file->updateFreeSpace(pageNo, *page);
+    page.release();
+  }
+  if (pageNo == Page::INVALID_NUMBER)
+    page = allocPage(file, pageNo);
+
+  page.markDirty();
+  const RecordId rid = page->insertRecord(record);
+  file->updateFreeSpace(pageNo, *page);
+  return rid;
 }
 
 void BufMgr::printSelf(void) 
@@ -238,13 +1084,341 @@ void BufMgr::printSelf(void)
 	{
   	tmpbuf = &(bufDescTable[i]);
 		std::cout << "FrameNo:" << i << " ";
-		tmpbuf->Print();
+		tmpbuf->Print(validBits.test(i), dirtyBits.test(i), refBits.test(i));
 
-  	if (tmpbuf->valid == true)
+  	if (validBits.test(i))
     	validFrames++;
   }
 
 	std::cout << "Total Number of Valid Frames:" << validFrames << "\n";
 }
 
+bool BufMgr::readOptimistic(File* file, const PageId pageNo, OptimisticRead& read)
+{
+  FrameId frameNo = 0;
+  try
+  {
+  	hashTable->lookup(file, pageNo, frameNo);
+  }
+  catch(HashNotFoundException e)
+  {
+  	return false;
+  }
+
+  read.frameNo = frameNo;
+  read.version = frameVersions[frameNo].load(std::memory_order_acquire);
+  if (read.version % 2 == 1)
+  	return false;
+
+  // the frame may have been given to another page since the lookup; a frame only changes hands while its
+  // version is odd, so the page it holds at this version is the one to check
+  if (!validBits.test(frameNo) || bufDescTable[frameNo].file != file || bufDescTable[frameNo].pageNo != pageNo)
+  	return false;
+  read.page = bufPool[frameNo];
+  return true;
+}
+
+void BufMgr::latchFrame(const FrameId frameNo)
+{
+  if (bufDescTable[frameNo].writeLatches++ == 0)
+  	beginFrameChange(frameNo);
+}
+
+void BufMgr::unlatchFrame(const FrameId frameNo)
+{
+  if (--bufDescTable[frameNo].writeLatches == 0)
+  	endFrameChange(frameNo);
+}
+
+void BufMgr::saveResidency(const std::string& path) const
+{
+  std::vector<const BufDesc*> resident;
+  for (std::uint32_t i = 0; i < numBufs; i++)
+  {
+  	if (validBits.test(i))
+  		resident.push_back(&bufDescTable[i]);
+  }
+  std::sort(resident.begin(), resident.end(),
+  		[](const BufDesc* a, const BufDesc* b) { return a->lastUsed > b->lastUsed; });
+
+  // write to a temporary file first so that a crash never leaves a truncated list behind
+  const std::string tmpPath = path + ".tmp";
+  std::ofstream out(tmpPath.c_str(), std::ios::out | std::ios::trunc);
+  if (!out)
+  	throw FileOpenException(tmpPath);
+
+  for (std::size_t i = 0; i < resident.size(); i++)
+  	out << resident[i]->pageNo << " " << resident[i]->file->filename() << "\n";
+  out.close();
+
+  if (!out || std::rename(tmpPath.c_str(), path.c_str()) != 0)
+  	throw FileOpenException(path);
+}
+
+std::uint32_t BufMgr::loadResidency(const std::string& path, const std::vector<File*>& files)
+{
+  std::ifstream in(path.c_str());
+  if (!in)
+  	throw FileNotFoundException(path);
+
+  std::map<std::string, File*> filesByName;
+  for (std::size_t i = 0; i < files.size(); i++)
+  	filesByName[files[i]->filename()] = files[i];
+
+  // pick the hottest pages that fit in the pool, grouped by file
+  std::map<File*, std::vector<PageId> > wanted;
+  std::uint32_t numWanted = 0;
+  PageId pageNo;
+  std::string filename;
+  while (numWanted < numBufs && in >> pageNo && std::getline(in >> std::ws, filename))
+  {
+  	std::map<std::string, File*>::iterator it = filesByName.find(filename);
+  	if (it == filesByName.end())
+  		continue;
+  	wanted[it->second].push_back(pageNo);
+  	numWanted++;
+  }
+
+  std::uint32_t numLoaded = 0;
+  for (std::map<File*, std::vector<PageId> >::iterator it = wanted.begin(); it != wanted.end(); ++it)
+  {
+  	// ascending page numbers turn the reads of each file into a forward sweep over it, read as one batch
+  	std::sort(it->second.begin(), it->second.end());
+  	std::vector<PageId> run;
+  	for (std::size_t i = 0; i < it->second.size(); i++)
+  	{
+  		FrameId frameNo = 0;
+  		try
+  		{
+  			hashTable->lookup(it->first, it->second[i], frameNo);
+  		}
+  		catch(HashNotFoundException e)
+  		{
+  			run.push_back(it->second[i]);
+  		}
+  	}
+
+  	while (!run.empty())
+  	{
+  		bool poolFull;
+  		const std::size_t numRead = loadPages(it->first, run, false /* readAhead */, poolFull);
+  		numLoaded += numRead;
+  		// every frame is pinned or reserved for another file
+  		if (poolFull)
+  			return numLoaded;
+  		// the page the batch stopped at was deleted after the list was saved, the rest of the run is read next
+  		run.erase(run.begin(), run.begin() + (numRead < run.size() ? numRead + 1 : numRead));
+  	}
+  }
+  return numLoaded;
+}
+
+BufStatsSnapshot BufMgr::getStatsSnapshot() const
+{
+  BufStatsSnapshot snapshot;
+  snapshot.totals = bufStats;
+  snapshot.files = fileStats;
+  snapshot.readLatency = readLatency.snapshot();
+  snapshot.writeLatency = writeLatency.snapshot();
+  return snapshot;
+}
+
+void BufMgr::clearBufStats()
+{
+  bufStats.clear();
+
+  // frames keep pointers to the per file entries, so reset them in place
+  for (std::map<std::string, BufFileStats>::iterator it = fileStats.begin(); it != fileStats.end(); ++it)
+  {
+  	BufFileStats empty = {0, 0, 0, 0};
+  	it->second = empty;
+  }
+
+  readLatency.clear();
+  writeLatency.clear();
+}
+
+static void dumpLatency(std::ostream& out, const char* name, const LatencySnapshot& latency)
+{
+  out << name << ": count=" << latency.count;
+  if (latency.count > 0)
+  {
+  	out << " avg=" << latency.totalNanos / latency.count << "ns"
+  	    << " p50<=" << latency.percentile(50) << "ns"
+  	    << " p90<=" << latency.percentile(90) << "ns"
+  	    << " p99<=" << latency.percentile(99) << "ns"
+  	    << " max<=" << latency.percentile(100) << "ns";
+  }
+  out << "\n";
+}
+
+void BufMgr::dumpStats(std::ostream& out) const
+{
+  BufStatsSnapshot snapshot = getStatsSnapshot();
+  const BufStats& totals = snapshot.totals;
+
+  out << "accesses=" << totals.accesses
+      << " hits=" << totals.hits
+      << " misses=" << totals.misses;
+  if (totals.hits + totals.misses > 0)
+  	out << " hitRatio=" << std::fixed << std::setprecision(3)
+  	    << (double) totals.hits / (totals.hits + totals.misses) << std::defaultfloat;
+  out << "\n";
+  out << "diskreads=" << totals.diskreads
+      << " diskwrites=" << totals.diskwrites
+      << " cleanEvictions=" << totals.cleanEvictions
+      << " dirtyEvictions=" << totals.dirtyEvictions
+      << " pinWaits=" << totals.pinWaits << "\n";
+  out << "prefetches=" << totals.prefetches
+      << " prefetchHits=" << totals.prefetchHits
+      << " wastedPrefetches=" << totals.wastedPrefetches << "\n";
+  out << "compressedStores=" << totals.compressedStores
+      << " compressedHits=" << totals.compressedHits
+      << " victimStores=" << totals.victimStores
+      << " victimHits=" << totals.victimHits << "\n";
+
+  for (std::map<std::string, BufFileStats>::const_iterator it = snapshot.files.begin(); it != snapshot.files.end(); ++it)
+  {
+  	out << "  " << it->first
+  	    << ": hits=" << it->second.hits
+  	    << " misses=" << it->second.misses
+  	    << " diskwrites=" << it->second.diskwrites
+  	    << " evictions=" << it->second.evictions << "\n";
+  }
+
+  dumpLatency(out, "read latency", snapshot.readLatency);
+  dumpLatency(out, "write latency", snapshot.writeLatency);
+}
+
+//----------------------------------------
+// LatencyHistogram
+//----------------------------------------
+
+LatencyHistogram::LatencyHistogram()
+{
+  clear();
+}
+
+void LatencyHistogram::record(const std::uint64_t nanos)
+{
+  // bucket i holds samples below 2^i
+  int bucket = 0;
+  for (std::uint64_t n = nanos; n != 0 && bucket < LatencySnapshot::NUM_BUCKETS - 1; n >>= 1)
+  	bucket++;
+
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+  totalNanos.fetch_add(nanos, std::memory_order_relaxed);
+}
+
+LatencySnapshot LatencyHistogram::snapshot() const
+{
+  LatencySnapshot snapshot;
+  for (int i = 0; i < LatencySnapshot::NUM_BUCKETS; i++)
+  	snapshot.buckets[i] = buckets[i].load(std::memory_order_relaxed);
+  snapshot.count = count.load(std::memory_order_relaxed);
+  snapshot.totalNanos = totalNanos.load(std::memory_order_relaxed);
+  return snapshot;
+}
+
+void LatencyHistogram::clear()
+{
+  for (int i = 0; i < LatencySnapshot::NUM_BUCKETS; i++)
+  	buckets[i].store(0, std::memory_order_relaxed);
+  count.store(0, std::memory_order_relaxed);
+  totalNanos.store(0, std::memory_order_relaxed);
+}
+
+std::uint64_t LatencySnapshot::percentile(const double pct) const
+{
+  // buckets may have been read while samples were being recorded, so go by their own total
+  std::uint64_t total = 0;
+  for (int i = 0; i < NUM_BUCKETS; i++)
+  	total += buckets[i];
+  if (total == 0)
+  	return 0;
+
+  std::uint64_t rank = (std::uint64_t) (pct / 100.0 * total + 0.5);
+  if (rank == 0)
+  	rank = 1;
+
+  std::uint64_t seen = 0;
+  for (int i = 0; i < NUM_BUCKETS; i++)
+  {
+  	seen += buckets[i];
+  	if (seen >= rank)
+  		return (std::uint64_t) 1 << i;
+  }
+  return (std::uint64_t) 1 << (NUM_BUCKETS - 1);
+}
+
+//----------------------------------------
+// PageHandle
+//----------------------------------------
+
+PageHandle::PageHandle()
+	: bufMgr(NULL), frameNo(0), pageNo(Page::INVALID_NUMBER), page(NULL), dirty(false) {
+}
+
+PageHandle::PageHandle(BufMgr* bufMgrIn, FrameId frameNoIn, PageId pageNoIn, Page* pageIn)
+	: bufMgr(bufMgrIn), frameNo(frameNoIn), pageNo(pageNoIn), page(pageIn), dirty(false) {
+}
+
+PageHandle::PageHandle(PageHandle&& other)
+	: bufMgr(other.bufMgr), frameNo(other.frameNo), pageNo(other.pageNo), page(other.page), dirty(other.dirty) {
+  other.page = NULL;
+  other.dirty = false;
+}
+
+PageHandle& PageHandle::operator=(PageHandle&& other)
+{
+  if (this != &other)
+  {
+    release();
+    bufMgr = other.bufMgr;
+    frameNo = other.frameNo;
+    pageNo = other.pageNo;
+    page = other.page;
+    dirty = other.dirty;
+    other.page = NULL;
+    other.dirty = false;
+  }
+  return *this;
+}
+
+PageHandle::~PageHandle()
+{
+  // destructors must not throw, a frame that is no longer pinned has nothing left to release
+  try
+  {
+    release();
+  }
+  catch(PageNotPinnedException e)
+  {
+  }
+}
+
+void PageHandle::markDirty()
+{
+  if (page != NULL && !dirty)
+  {
+    dirty = true;
+    bufMgr->latchFrame(frameNo);
+  }
+}
+
+void PageHandle::release()
+{
+  if (page == NULL)
+    return;
+
+  // clear the handle first so it is empty even if the unpin throws
+  page = NULL;
+  bool wasDirty = dirty;
+  dirty = false;
+  if (wasDirty)
+    bufMgr->unlatchFrame(frameNo);
+  bufMgr->unPinFrame(frameNo, wasDirty);
+}
+
 }
@@ -9,7 +9,14 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "compressedCache.h"
+#include "victimCache.h"
+#include <atomic>
 #include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
 
 namespace badgerdb {
 
@@ -17,6 +24,30 @@ namespace badgerdb {
 * forward declaration of BufMgr class 
 */
 class BufMgr;
+struct BufFileStats;
+
+/**
+* @brief Partition of the buffer pool reserved for, or capped to, the pages of one file
+*/
+struct BufQuota
+{
+	/**
+   * Number of frames reserved for the file. Pages of the file are not chosen as victims for pages
+   * of other files while the file holds this many frames or fewer.
+	 */
+  std::uint32_t minFrames;
+
+	/**
+   * Maximum number of frames the file may hold, 0 if there is no cap. Once the file holds this many
+   * frames, a new page of the file can only replace another page of the same file.
+	 */
+  std::uint32_t maxFrames;
+
+	/**
+   * Number of frames currently holding pages of the file
+	 */
+  std::uint32_t resident;
+};
 
 /**
 * @brief Class for maintaining information about buffer pool frames
@@ -42,56 +73,77 @@ class BufDesc {
   FrameId	frameNo;
 
 	/**
-   * Number of times this page has been pinned
+   * Number of times this page has been pinned. A thread which pins the page repeatedly counts once for as long
+   * as it holds a pin, see BufMgr::pinFrame().
 	 */
   int pinCnt;
 
 	/**
-   * True if page is dirty;  false otherwise
+   * Value of the buffer manager's use counter when the page was last pinned, higher is more recent
 	 */
-  bool dirty;
+  std::uint64_t lastUsed;
+
+	/**
+   * True if the page was read ahead of time and has not been asked for yet
+	 */
+  bool prefetched;
+
+	/**
+   * Number of page handles which have declared they modify the page, see PageHandle::markDirty()
+	 */
+  std::uint32_t writeLatches;
 
 	/**
-   * True if page is valid
+   * Generation of the frame, changed every time the frame is cleared, so that pins a thread remembers for an
+   * earlier page in the frame are not taken for pins of the current one. Kept by Clear().
 	 */
-  bool valid;
+  std::uint64_t generation;
 
 	/**
-   * Has this buffer frame been reference recently
+   * Partition of the file the page belongs to, NULL if the file has no quota
 	 */
-  bool refbit;
+  BufQuota* quota;
 
 	/**
-   * Initialize buffer frame for a new user
+   * Statistics of the file the page belongs to
+	 */
+  BufFileStats* fileStats;
+
+	/**
+   * Initialize buffer frame for a new user. The valid, dirty, referenced and pinned flags of the frame are kept
+   * by BufMgr, see BufMgr::clearFrame().
 	 */
   void Clear()
 	{
+		quota = NULL;
+		fileStats = NULL;
     pinCnt = 0;
 		file = NULL;
 		pageNo = Page::INVALID_NUMBER;
-    dirty = false;
-    refbit = false;
-		valid = false;
+		lastUsed = 0;
+		prefetched = false;
+		writeLatches = 0;
   };
 
 	/**
 	 * Set values of member variables corresponding to assignment of frame to a page in the file. Called when a frame 
-	 * in buffer pool is allocated to any page in the file through readPage() or allocPage()
+	 * in buffer pool is allocated to any page in the file through readPage() or allocPage(). The flags of the frame
+	 * are set by BufMgr::setFrame().
 	 *
 	 * @param filePtr	File object
 	 * @param pageNum	Page number in the file
+	 * @param quotaPtr	Partition of the file, NULL if the file has no quota
+	 * @param statsPtr	Statistics of the file
 	 */
-  void Set(File* filePtr, PageId pageNum)
+  void Set(File* filePtr, PageId pageNum, BufQuota* quotaPtr, BufFileStats* statsPtr)
 	{ 
+		quota = quotaPtr;
+		fileStats = statsPtr;
 		file = filePtr;
     pageNo = pageNum;
-    pinCnt = 1;
-    dirty = false;
-    valid = true;
-    refbit = true;
   }
 
-  void Print()
+  void Print(bool valid, bool dirty, bool refbit)
 	{
 		if(file != NULL)
 		{
@@ -112,37 +164,156 @@ class BufDesc {
 	 */
   BufDesc()
 	{
+  	generation = 0;
   	Clear();
   }
 };
 
 
+/**
+* @brief Dense bitset with one bit per buffer frame. The clock sweep tests the flags of 64 frames per word instead of
+* loading every descriptor.
+*/
+class FrameBits
+{
+ public:
+	/**
+   * Number of frames per word
+	 */
+  static const std::uint32_t BITS_PER_WORD = 64;
+
+	/**
+   * Changes the number of frames. Bits of new frames are clear, bits of frames past the new end are dropped.
+	 */
+  void resize(std::uint32_t numFrames)
+  {
+		if (numFrames % BITS_PER_WORD != 0 && numFrames / BITS_PER_WORD < words.size())
+			words[numFrames / BITS_PER_WORD] &= (((std::uint64_t) 1) << (numFrames % BITS_PER_WORD)) - 1;
+		words.resize((numFrames + BITS_PER_WORD - 1) / BITS_PER_WORD, 0);
+  }
+
+  bool test(FrameId frameNo) const
+  {
+		return (words[frameNo / BITS_PER_WORD] >> (frameNo % BITS_PER_WORD)) & 1;
+  }
+
+  void set(FrameId frameNo)
+  {
+		words[frameNo / BITS_PER_WORD] |= ((std::uint64_t) 1) << (frameNo % BITS_PER_WORD);
+  }
+
+  void reset(FrameId frameNo)
+  {
+		words[frameNo / BITS_PER_WORD] &= ~(((std::uint64_t) 1) << (frameNo % BITS_PER_WORD));
+  }
+
+	/**
+   * Returns the word holding the bits of frames wordNo * 64 to wordNo * 64 + 63, lowest frame in the lowest bit
+	 */
+  std::uint64_t word(std::uint32_t wordNo) const
+  {
+		return words[wordNo];
+  }
+
+  std::uint64_t& word(std::uint32_t wordNo)
+  {
+		return words[wordNo];
+  }
+
+ private:
+  std::vector<std::uint64_t> words;
+};
+
+
 /**
 * @brief Class to maintain statistics of buffer usage 
 */
 struct BufStats
 {
 	/**
-   * Total number of accesses to buffer pool
+   * Total number of accesses to buffer pool (readPage and allocPage calls)
 	 */
-  int accesses;
+  std::uint64_t accesses;
+
+	/**
+   * Number of readPage calls satisfied from the buffer pool
+	 */
+  std::uint64_t hits;
+
+	/**
+   * Number of readPage calls which had to read the page from disk
+	 */
+  std::uint64_t misses;
 
 	/**
    * Number of pages read from disk (including allocs)
 	 */
-  int diskreads;
+  std::uint64_t diskreads;
 
 	/**
    * Number of pages written back to disk
 	 */
-  int diskwrites;
+  std::uint64_t diskwrites;
+
+	/**
+   * Number of clean pages evicted to make room for another page
+	 */
+  std::uint64_t cleanEvictions;
+
+	/**
+   * Number of dirty pages evicted, and written back, to make room for another page
+	 */
+  std::uint64_t dirtyEvictions;
+
+	/**
+   * Number of times the clock had to pass over an unreferenced frame because it was pinned
+	 */
+  std::uint64_t pinWaits;
+
+	/**
+   * Number of pages read ahead of time
+	 */
+  std::uint64_t prefetches;
+
+	/**
+   * Number of pages read ahead of time which were asked for before being evicted
+	 */
+  std::uint64_t prefetchHits;
+
+	/**
+   * Number of pages read ahead of time which were evicted without being asked for
+	 */
+  std::uint64_t wastedPrefetches;
+
+	/**
+   * Number of evicted pages stored in the compressed tier
+	 */
+  std::uint64_t compressedStores;
+
+	/**
+   * Number of misses served from the compressed tier instead of disk
+	 */
+  std::uint64_t compressedHits;
+
+	/**
+   * Number of evicted pages written to the victim cache file
+	 */
+  std::uint64_t victimStores;
+
+	/**
+   * Number of misses served from the victim cache file instead of the file of the page
+	 */
+  std::uint64_t victimHits;
 
 	/**
    * Clear all values 
 	 */
   void clear()
   {
-		accesses = diskreads = diskwrites = 0;
+		accesses = hits = misses = diskreads = diskwrites = 0;
+		cleanEvictions = dirtyEvictions = pinWaits = 0;
+		prefetches = prefetchHits = wastedPrefetches = 0;
+		compressedStores = compressedHits = victimStores = victimHits = 0;
   }
       
 	/**
@@ -156,140 +327,922 @@ struct BufStats
 
 
 /**
-* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+* @brief Buffer usage statistics of the pages of one file
 */
-class BufMgr 
+struct BufFileStats
 {
- private:
 	/**
-   * Current position of clockhand in our buffer pool
+   * Number of readPage calls for the file satisfied from the buffer pool
 	 */
-  FrameId clockHand;
+  std::uint64_t hits;
 
 	/**
-   * Number of frames in the buffer pool
+   * Number of readPage calls for the file which had to read the page from disk
 	 */
-  std::uint32_t numBufs;
-	
+  std::uint64_t misses;
+
 	/**
-   * Hash table mapping (File, page) to frame
+   * Number of pages of the file written back to disk
 	 */
-  BufHashTbl *hashTable;
+  std::uint64_t diskwrites;
 
 	/**
-   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+   * Number of pages of the file evicted to make room for another page
 	 */
-  BufDesc *bufDescTable;
+  std::uint64_t evictions;
+};
 
+
+/**
+* @brief Access pattern of one file, used to detect sequential and strided runs of readPage calls
+*/
+struct BufReadahead
+{
 	/**
-   * Maintains Buffer pool usage statistics 
+   * Page number of the last readPage call for the file, Page::INVALID_NUMBER before the first one
 	 */
-  BufStats bufStats;
+  PageId lastPageNo;
 
 	/**
-	 * Allocate a free frame.  
-	 *
-	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
-	 * @throws BufferExceededException If no such buffer is found which can be allocated
+   * Distance between the last two page numbers asked for
 	 */
-  void allocBuf(FrameId & frame);
+  std::int64_t stride;
 
 	/**
-   * Advance clock to next frame in the buffer pool
+   * Number of consecutive calls which moved by the same stride
 	 */
-  void advanceClock()
-  {
-		clockHand = (clockHand + 1) % numBufs;
-  }
+  std::uint32_t runLength;
 
+	/**
+   * Number of pages to keep read ahead of the last page asked for. Grows while read ahead pages are
+   * used and shrinks when they are evicted unused.
+	 */
+  std::uint32_t window;
 
- public:
 	/**
-   * Actual buffer pool from which frames are allocated
+   * Next page number of the run to be read ahead
+	 */
+  std::int64_t nextPrefetch;
+};
+
+
+/**
+* @brief Per file state of a buffer manager, cached by file id so that the hot paths need no lookup by file name
+*/
+struct BufFileSlot
+{
+	/**
+   * Name of the file the slot was filled for, NULL if the slot is empty. Once a file is closed its id goes to
+   * the next file opened, so the name tells whether the slot is still the one of the file asking.
 	 */
-  Page* bufPool;
+  const std::string* name;
 
 	/**
-   * Constructor of BufMgr class
+   * Partition of the file, NULL if the file has no quota
 	 */
-  BufMgr(std::uint32_t bufs);
-	
+  BufQuota* quota;
+
 	/**
-   * Destructor of BufMgr class
+   * Statistics of the file
 	 */
-  ~BufMgr();
+  BufFileStats* stats;
 
 	/**
-	 * Reads the given page from the file into a frame and returns the pointer to page.
-	 * If the requested page is already present in the buffer pool pointer to that frame is returned
-	 * otherwise a new frame is allocated from the buffer pool for reading the page.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number in the file to be read
-	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+   * Access pattern of the file
 	 */
-  void readPage(File* file, const PageId PageNo, Page*& page);
+  BufReadahead* readahead;
+};
+
 
+/**
+* @brief Snapshot of a latency histogram
+*/
+struct LatencySnapshot
+{
 	/**
-	 * Unpin a page from memory since it is no longer required for it to remain in memory.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
-	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
-   * @throws  PageNotPinnedException If the page is not already pinned
+   * Number of buckets. Bucket i counts latencies of at least 2^(i-1) and less than 2^i nanoseconds;
+   * bucket 0 counts latencies below one nanosecond and the last bucket everything above its lower bound.
 	 */
-  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+  static const int NUM_BUCKETS = 40;
 
 	/**
-	 * Allocates a new, empty page in the file and returns the Page object.
-	 * The newly allocated page is also assigned a frame in the buffer pool.
-	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
-	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+   * Number of samples in every bucket
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+  std::uint64_t buckets[NUM_BUCKETS];
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
-	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
-	 * Otherwise Error returned.
-	 *
-	 * @param file   	File object
-   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
-   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+   * Total number of samples
 	 */
-  void flushFile(const File* file);
+  std::uint64_t count;
 
 	/**
-	 * Delete page from file and also from buffer pool if present.
-	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+   * Sum of all samples in nanoseconds
+	 */
+  std::uint64_t totalNanos;
+
+	/**
+   * Returns an upper bound, in nanoseconds, of the given percentile (0 to 100) of the samples.
+	 */
+  std::uint64_t percentile(const double pct) const;
+};
+
+
+/**
+* @brief Log-bucketed latency histogram. Recording a sample is lock-free, so it can be shared by threads.
+*/
+class LatencyHistogram
+{
+ public:
+  LatencyHistogram();
+
+	/**
+   * Records one sample.
 	 *
-	 * @param file   	File object
-	 * @param PageNo  Page number
+	 * @param nanos	Latency in nanoseconds
 	 */
-  void disposePage(File* file, const PageId PageNo);
+  void record(const std::uint64_t nanos);
 
 	/**
-   * Print member variable values. 
+   * Returns a copy of the current counts. Samples recorded concurrently may or may not be included.
 	 */
-  void  printSelf();
+  LatencySnapshot snapshot() const;
 
 	/**
-   * Get buffer pool usage statistics
+   * Clear all samples
 	 */
-  BufStats & getBufStats()
-  {
-		return bufStats;
-  }
+  void clear();
+
+ private:
+  std::atomic<std::uint64_t> buckets[LatencySnapshot::NUM_BUCKETS];
+  std::atomic<std::uint64_t> count;
+  std::atomic<std::uint64_t> totalNanos;
+};
 
+
+/**
+* @brief Point in time copy of all buffer pool statistics, as returned by BufMgr::getStatsSnapshot()
+*/
+struct BufStatsSnapshot
+{
 	/**
-   * Clear buffer pool usage statistics
+   * Totals over all files
 	 */
-  void clearBufStats() 
-  {
-		bufStats.clear();
-  }
+  BufStats totals;
+
+	/**
+   * Statistics of every file which has been accessed, keyed by file name
+	 */
+  std::map<std::string, BufFileStats> files;
+
+	/**
+   * Latencies of page reads from disk; a batch of pages read together is one sample
+	 */
+  LatencySnapshot readLatency;
+
+	/**
+   * Latencies of page writes to disk; a batch of pages written together is one sample
+	 */
+  LatencySnapshot writeLatency;
+};
+
+
+/**
+* @brief Result of BufMgr::readOptimistic(). The page may be read through it without being pinned, but whatever
+* was read is only trustworthy once BufMgr::validate() has confirmed the frame did not change meanwhile.
+*/
+struct OptimisticRead
+{
+	/**
+   * Frame the page was found in
+	 */
+  FrameId frameNo;
+
+	/**
+   * Version of the frame when the read started
+	 */
+  std::uint64_t version;
+
+	/**
+   * Page in the frame, not pinned
+	 */
+  const Page* page;
+};
+
+
+/**
+* @brief Movable handle to a page pinned in the buffer pool.
+*
+* A handle remembers the frame its page is pinned in, so unpinning it does not need another hash table
+* lookup. The page is unpinned when the handle is destroyed or release() is called, whichever comes first.
+* Handles can be moved but not copied, so each pin is released exactly once.
+*/
+class PageHandle
+{
+	friend class BufMgr;
+
+ public:
+	/**
+   * Constructs an empty handle which does not refer to any page.
+	 */
+  PageHandle();
+
+	/**
+   * Move constructor. The other handle is left empty.
+	 */
+  PageHandle(PageHandle&& other);
+
+	/**
+   * Move assignment. The page currently held by this handle, if any, is released first.
+	 */
+  PageHandle& operator=(PageHandle&& other);
+
+	/**
+   * Destructor of PageHandle class. Unpins the page if it is still held.
+	 */
+  ~PageHandle();
+
+  PageHandle(const PageHandle&) = delete;
+  PageHandle& operator=(const PageHandle&) = delete;
+
+	/**
+   * Returns pointer to the pinned page, or NULL if the handle is empty.
+	 */
+  Page* get() const { return page; }
+
+  Page* operator->() const { return page; }
+
+  Page& operator*() const { return *page; }
+
+	/**
+   * Returns true if the handle currently holds a pinned page.
+	 */
+  bool isValid() const { return page != NULL; }
+
+	/**
+   * Returns page number, in its file, of the pinned page.
+	 */
+  PageId getPageNo() const { return pageNo; }
+
+	/**
+   * Returns frame number, in the buffer pool, of the pinned page.
+	 */
+  FrameId getFrameNo() const { return frameNo; }
+
+	/**
+   * Marks the page dirty. It will be marked dirty in the buffer pool when the handle is released.
+   * Call it before modifying the page: until the handle is released the frame is latched exclusively, so
+   * optimistic readers of the page (see BufMgr::readOptimistic()) fail to validate and fall back to pinning.
+	 */
+  void markDirty();
+
+	/**
+	 * Unpins the page now instead of waiting for the handle to be destroyed. The handle is left empty.
+	 * Calling release() on an empty handle does nothing.
+	 *
+   * @throws  PageNotPinnedException If the frame is no longer pinned
+	 */
+  void release();
+
+ private:
+	/**
+   * Constructs a handle for a page already pinned in frame 'frameNoIn' of 'bufMgrIn'.
+	 */
+  PageHandle(BufMgr* bufMgrIn, FrameId frameNoIn, PageId pageNoIn, Page* pageIn);
+
+	/**
+   * Buffer manager the page is pinned in
+	 */
+  BufMgr* bufMgr;
+
+	/**
+   * Frame the page is pinned in
+	 */
+  FrameId frameNo;
+
+	/**
+   * Page number of the pinned page in its file
+	 */
+  PageId pageNo;
+
+	/**
+   * Pinned page, NULL if the handle is empty
+	 */
+  Page* page;
+
+	/**
+   * True if the page has to be marked dirty when it is released. The handle holds a write latch on the frame
+   * while this is set.
+	 */
+  bool dirty;
+};
+
+
+/**
+* @brief The central class which manages the buffer pool including frame allocation and deallocation to pages in the file 
+*/
+class BufMgr 
+{
+	friend class PageHandle;
+
+ private:
+	/**
+   * Id of the buffer manager, never given to another one, so that pins a thread remembers are told apart from
+   * those of an earlier manager at the same address
+	 */
+  std::uint64_t managerId;
+
+	/**
+   * Last generation given to a frame, see BufDesc::generation
+	 */
+  std::uint64_t generationClock;
+
+	/**
+   * Current position of clockhand in our buffer pool
+	 */
+  FrameId clockHand;
+
+	/**
+   * Number of frames in the buffer pool
+	 */
+  std::uint32_t numBufs;
+	
+	/**
+   * Hash table mapping (File, page) to frame
+	 */
+  BufHashTbl *hashTable;
+
+	/**
+   * Array of BufDesc objects to hold information corresponding to every frame allocation from 'bufPool' (the buffer pool)
+	 */
+  BufDesc *bufDescTable;
+
+	/**
+   * Flags of every frame used by the clock sweep, kept apart from the descriptors: frame holds a page,
+   * was referenced recently, is pinned, and holds a modified page.
+	 */
+  FrameBits validBits;
+  FrameBits refBits;
+  FrameBits pinnedBits;
+  FrameBits dirtyBits;
+
+	/**
+	 * Assigns the frame to a page in the file, pinned once and referenced.
+	 *
+	 * @param frameNo	Frame number
+	 * @param file   	File object
+	 * @param pageNo	Page number in the file
+	 * @param quota		Partition of the file, NULL if the file has no quota
+	 * @param stats		Statistics of the file
+	 */
+  void setFrame(const FrameId frameNo, File* file, const PageId pageNo, BufQuota* quota, BufFileStats* stats);
+
+	/**
+	 * Resets the frame so that it holds no page.
+	 *
+	 * @param frameNo	Frame number
+	 */
+  void clearFrame(const FrameId frameNo);
+
+	/**
+	 * Leaves a page read into a frame ahead of time unpinned and unreferenced, so that it is the first to go if it
+	 * is not asked for.
+	 *
+	 * @param frameNo	Frame number
+	 */
+  void unpinLoadedFrame(const FrameId frameNo)
+  {
+		unPinFrame(frameNo, false);
+		refBits.reset(frameNo);
+  }
+
+	/**
+   * Maintains Buffer pool usage statistics 
+	 */
+  BufStats bufStats;
+
+	/**
+   * Buffer pool usage statistics of every file, keyed by file name
+	 */
+  std::map<std::string, BufFileStats> fileStats;
+
+	/**
+   * Latencies of page reads from disk; a batch of pages read together is one sample
+	 */
+  LatencyHistogram readLatency;
+
+	/**
+   * Latencies of page writes to disk; a batch of pages written together is one sample
+	 */
+  LatencyHistogram writeLatency;
+
+	/**
+   * Frame reservations and caps, keyed by file name
+	 */
+  std::map<std::string, BufQuota> fileQuotas;
+
+	/**
+	 * Frames which hold no page, ready to be handed out by allocBuf() without a clock sweep
+	 */
+  std::vector<FrameId> freeFrames;
+
+	/**
+	 * Largest number of victims evicted by one clock sweep
+	 */
+  static const std::uint32_t MAX_EVICTION_BATCH = 8;
+
+	/**
+	 * Allocate a free frame.  
+	 * A frame is taken from the free frame list if there is one. Otherwise the clock sweep collects a batch of
+	 * victims: one is returned and the rest are put on the free frame list, after the dirty ones have been written
+	 * back in file and page order.
+	 * Victims are chosen so that partitions of other files do not drop below their reserved size, and so that
+	 * a file which has reached its cap only replaces its own pages.
+	 *
+	 * @param frame   	Frame reference, frame ID of allocated frame returned via this variable
+	 * @param quota   	Partition of the file the frame is allocated for, NULL if the file has no quota
+	 * @throws BufferExceededException If no such buffer is found which can be allocated
+	 * @throws FileIOException If a dirty victim cannot be written back; the victims then stay in the pool
+	 */
+  void allocBuf(FrameId & frame, BufQuota* quota);
+
+	/**
+	 * Evicts the page held in a victim frame chosen by allocBuf() and clears the frame. A dirty page must
+	 * have been written back already.
+	 *
+	 * @param frameNo	Frame number
+	 */
+  void evictFrame(const FrameId frameNo);
+
+	/**
+	 * Per file state of the buffer manager by file id, see lookupFile()
+	 */
+  std::vector<BufFileSlot> fileSlots;
+
+	/**
+	 * Returns the quota, statistics and access pattern of the given file, found through its id. Only the first
+	 * call for a file, and the first one after its id was given to it, looks them up by name, creating the
+	 * statistics and access pattern on first use. The slot stays valid until the next call, or until a quota is
+	 * set or cleared.
+	 *
+	 * @param file   	File object
+	 */
+  const BufFileSlot& lookupFile(const File* file);
+
+	/**
+	 * Writes the page held in the given frame back to its file, updating the statistics.
+	 *
+	 * @param frameNo	Frame number
+	 */
+  void writeFrame(const FrameId frameNo);
+
+	/**
+	 * Writes the pages held in the given frames back to their files, updating the statistics. The pages of
+	 * each file are handed to the I/O engine as one batch, so frames should be sorted with sortFrames().
+	 *
+	 * @param frames	Frame numbers
+	 * @param count		Number of frames
+	 */
+  void writeFrames(const FrameId* frames, const std::size_t count);
+
+	/**
+	 * Sorts frames by the file and page number of the pages they hold.
+	 */
+  void sortFrames(FrameId* frames, const std::size_t count) const;
+
+	/**
+   * Number of reads and writes the I/O engine has in flight at most
+	 */
+  static const std::uint32_t IO_QUEUE_DEPTH = 64;
+
+	/**
+   * Engine for batches of page reads and writes, such as readahead, eviction and flushes
+	 */
+  IoEngine* ioEngine;
+
+	/**
+	 * Reads a page which is not in the buffer pool into a newly allocated frame and pins it.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @return  			Frame number the page is pinned in
+	 */
+  FrameId fetchPage(File* file, const PageId pageNo);
+
+	/**
+   * Counter advanced every time a page is pinned, used to order the frames by recency
+	 */
+  std::uint64_t useClock;
+
+	/**
+   * Version of every frame, odd while the page in the frame is being replaced or modified. Kept apart from the
+   * descriptors so that optimistic readers only ever load from it.
+	 */
+  std::atomic<std::uint64_t>* frameVersions;
+
+	/**
+	 * Starts a change of the page held in the frame: optimistic reads of it fail until endFrameChange().
+	 *
+	 * @param frameNo	Frame number
+	 */
+  void beginFrameChange(const FrameId frameNo)
+  {
+		frameVersions[frameNo].fetch_add(1, std::memory_order_acq_rel);
+  }
+
+	/**
+	 * Ends a change of the page held in the frame started by beginFrameChange().
+	 *
+	 * @param frameNo	Frame number
+	 */
+  void endFrameChange(const FrameId frameNo)
+  {
+		frameVersions[frameNo].fetch_add(1, std::memory_order_release);
+  }
+
+	/**
+	 * Takes a write latch on the frame for a page handle. The first latch starts a frame change.
+	 *
+	 * @param frameNo	Frame number
+	 */
+  void latchFrame(const FrameId frameNo);
+
+	/**
+	 * Drops a write latch taken with latchFrame(). The last latch ends the frame change.
+	 *
+	 * @param frameNo	Frame number
+	 */
+  void unlatchFrame(const FrameId frameNo);
+
+	/**
+   * Access patterns of every file read through readPage, keyed by file name
+	 */
+  std::map<std::string, BufReadahead> readaheads;
+
+	/**
+   * Names of the files written to since the last checkpoint. Names rather than File objects are kept, since a
+   * file may be closed after flushFile() and before the checkpoint.
+	 */
+  std::set<std::string> unsyncedFiles;
+
+	/**
+   * True if readPage reads ahead on sequential and strided runs
+	 */
+  bool readaheadEnabled;
+
+	/**
+   * Compressed copies of pages evicted from the pool, checked on a miss before reading from disk
+	 */
+  CompressedCache compressedCache;
+
+	/**
+   * Cache file for pages evicted from the pool, checked on a miss after the compressed tier. NULL if not set up.
+	 */
+  VictimCache* victimCache;
+
+	/**
+	 * Records a readPage call in the access pattern of the file. Once the last calls form a run with a
+	 * constant stride, the following pages of the run are read into the pool, unpinned, up to the
+	 * readahead window of the file.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number asked for
+	 * @param prefetchHit	True if the page had been read ahead
+	 */
+  void readAhead(File* file, const PageId pageNo, const bool prefetchHit);
+
+	/**
+	 * Reads pages which are not in the pool into it, unpinned, with the reads from disk going to the I/O
+	 * engine as one batch. Stops at the first page which does not exist in the file, or when no frame can
+	 * be found.
+	 *
+	 * @param file   	File object
+	 * @param pageNos	Numbers of the pages to read
+	 * @param readAhead	True if the pages are read ahead of a run, so that they count as prefetches
+	 * @param poolFull	Set to true if the pages stopped for lack of a frame rather than at a missing page
+	 * @return  			Number of pages from the start of pageNos which are now in the pool
+	 */
+  std::size_t loadPages(File* file, const std::vector<PageId>& pageNos, const bool readAhead, bool& poolFull);
+
+	/**
+   * Returns the largest readahead window, so that read ahead pages cannot take over the pool
+	 */
+  std::uint32_t maxReadaheadWindow() const;
+
+	/**
+   * Returns size of the hash table used for a buffer pool with the given number of frames
+	 */
+  static int hashTableSize(std::uint32_t bufs);
+
+	/**
+   * Advance clock to next frame in the buffer pool
+	 */
+  void advanceClock()
+  {
+		clockHand = (clockHand + 1) % numBufs;
+  }
+
+	/**
+	 * Pins the given page in a frame, reading it from the file if it is not already in the buffer pool.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @return  			Frame number the page is pinned in
+	 */
+  FrameId pinPage(File* file, const PageId PageNo);
+
+	/**
+	 * Allocates a new page in the file and pins it in a frame.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @return  			Frame number the new page is pinned in
+	 */
+  FrameId pinNewPage(File* file, PageId &PageNo);
+
+	/**
+	 * Unpin the page held in the given frame. Used by unPinPage() after the hash table lookup and directly
+	 * by PageHandle, which already knows the frame.
+	 *
+	 * @param frameNo	Frame number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty
+   * @throws  PageNotPinnedException If the page is not already pinned
+	 */
+  void unPinFrame(const FrameId frameNo, const bool dirty);
+
+	/**
+	 * Pins the page held in the given frame. Pins are counted per thread first: only the first pin a thread
+	 * takes on the frame, and the last one it drops, update the shared pin count. A thread holding pins on more
+	 * frames than it has local slots for counts the extra pins in the shared pin count directly.
+	 *
+	 * @param frameNo	Frame number
+	 */
+  void pinFrame(const FrameId frameNo);
+
+
+ public:
+	/**
+   * Actual buffer pool from which frames are allocated. Every frame is a separate Page object,
+   * so pages stay at the same address when the pool is resized.
+	 */
+  std::vector<Page*> bufPool;
+
+	/**
+   * Constructor of BufMgr class
+	 */
+  BufMgr(std::uint32_t bufs);
+	
+	/**
+   * Destructor of BufMgr class
+	 */
+  ~BufMgr();
+
+	/**
+	 * Changes the number of frames in the buffer pool while it is in use.
+	 * Growing adds empty frames at the end of the pool. Shrinking evicts the pages held in the frames past
+	 * the new size, writing dirty ones back to disk first. Pages in the remaining frames are not touched, so
+	 * pointers and handles to them stay valid. The hash table is rehashed for the new size.
+	 *
+	 * @param newBufs	New number of frames
+   * @throws  PagePinnedException If a page in one of the frames to be removed is pinned. The pool is left unchanged.
+   * @throws  BufferExceededException If newBufs is zero
+	 */
+  void resize(std::uint32_t newBufs);
+
+	/**
+	 * Writes the list of pages resident in the buffer pool to a file, most recently used first, so that
+	 * loadResidency() can warm up the pool after a restart. Each line holds the page number and the name
+	 * of the file the page belongs to.
+	 *
+	 * @param path	Name of the file to write the list to
+   * @throws  FileOpenException If the list cannot be written
+	 */
+  void saveResidency(const std::string& path) const;
+
+	/**
+	 * Turns readahead on or off. It is on by default.
+	 *
+	 * @param enabled	True to read ahead on sequential and strided runs of readPage calls
+	 */
+  void setReadahead(const bool enabled)
+  {
+		readaheadEnabled = enabled;
+  }
+
+	/**
+	 * Sets the memory for the compressed tier behind the pool. Evicted pages are kept there compressed and
+	 * misses are served from it before going to disk. The tier is off by default.
+	 *
+	 * @param bytes	Maximum number of compressed bytes held, 0 to turn the tier off
+	 */
+  void setCompressedCache(const std::size_t bytes)
+  {
+		compressedCache.setCapacity(bytes);
+  }
+
+	/**
+	 * Sets up a cache file for pages evicted from the pool, replacing any earlier one. The cache file should
+	 * be on a faster device than the files read through the pool: evicted pages are written to it, and misses
+	 * are served from it before going to the file of the page. There is no cache file by default.
+	 *
+	 * @param path 	Name of the cache file, which is created and removed again when the cache is replaced
+	 * @param pages	Number of pages the cache file holds, 0 to remove the cache file
+   * @throws  FileNotFoundException If the cache file cannot be created
+	 */
+  void setVictimCache(const std::string& path, const std::uint32_t pages);
+
+	/**
+	 * Reads back pages listed by saveResidency(). Only pages of the given open files are loaded, and no
+	 * more than fit in the pool, hottest first. The pages of each file are read in ascending page number
+	 * order, as one batch through the I/O engine, and are left unpinned. Pages which are already in the pool
+	 * or no longer exist are skipped.
+	 *
+	 * @param path	Name of the file the list was written to
+	 * @param files	Open files whose pages may be loaded
+	 * @return  		Number of pages read into the pool
+   * @throws  FileNotFoundException If the list does not exist
+	 */
+  std::uint32_t loadResidency(const std::string& path, const std::vector<File*>& files);
+
+	/**
+	 * Reserves frames for, and/or caps the number of frames held by, the pages of the named file.
+	 * Reservations of all files together should leave some frames for files without one; otherwise
+	 * allocations for those files fail with BufferExceededException once the pool is full.
+	 * Setting the quota of a file again replaces its limits.
+	 *
+	 * @param filename	Name of the file
+	 * @param minFrames	Number of frames reserved for the file
+	 * @param maxFrames	Maximum number of frames the file may hold, 0 for no cap
+	 */
+  void setFileQuota(const std::string& filename, std::uint32_t minFrames, std::uint32_t maxFrames);
+
+	/**
+	 * Removes the quota of the named file, if any. Its pages compete for frames like any other pages afterwards.
+	 *
+	 * @param filename	Name of the file
+	 */
+  void clearFileQuota(const std::string& filename);
+
+	/**
+	 * Returns the quota of the named file together with the number of frames its pages currently hold.
+	 * A file without a quota is reported with all values 0.
+	 *
+	 * @param filename	Name of the file
+	 */
+  BufQuota getFileQuota(const std::string& filename) const;
+
+	/**
+	 * Reads the given page from the file into a frame and returns the pointer to page.
+	 * If the requested page is already present in the buffer pool pointer to that frame is returned
+	 * otherwise a new frame is allocated from the buffer pool for reading the page.
+	 * Sequential and strided runs of calls for the same file make the following pages be read ahead.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Used to fetch the Page object in which requested page from file is read in.
+	 */
+  void readPage(File* file, const PageId PageNo, Page*& page);
+
+	/**
+	 * Reads the given page from the file into a frame and returns a handle pinning it.
+	 * The page is unpinned when the handle is released or destroyed, without another hash table lookup.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number in the file to be read
+	 * @return  			Handle to the pinned page
+	 */
+  PageHandle readPage(File* file, const PageId PageNo);
+
+	/**
+	 * Unpin a page from memory since it is no longer required for it to remain in memory.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 * @param dirty		True if the page to be unpinned needs to be marked dirty	
+   * @throws  PageNotPinnedException If the page is not already pinned
+	 */
+  void unPinPage(File* file, const PageId PageNo, const bool dirty);
+
+	/**
+	 * Allocates a new, empty page in the file and returns the Page object.
+	 * The newly allocated page is also assigned a frame in the buffer pool.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 */
+  void allocPage(File* file, PageId &PageNo, Page*& page); 
+
+	/**
+	 * Allocates a new, empty page in the file and returns a handle pinning it.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
+	 * @return  			Handle to the newly allocated page
+	 */
+  PageHandle allocPage(File* file, PageId &PageNo);
+
+	/**
+	 * Inserts a record into a page of the file with room for it, allocating a page only if there is none. Like
+	 * PageFile::insertRecord(), the page is found through the free space map of the file, but it is read and
+	 * changed in the buffer pool, so frames holding pages of the file stay current.
+	 *
+	 * @param file   	File object
+	 * @param record  Bytes that compose the record
+	 * @return  			ID of the inserted record
+   * @throws  InsufficientSpaceException If the record does not fit into an empty page
+	 */
+  RecordId insertRecord(PageFile* file, const std::string& record);
+
+	/**
+	 * Starts an optimistic read of a page: the page is neither pinned nor referenced, so readers do not write to
+	 * any shared state. The frame is checked to still hold the page once its version is known, so a frame given
+	 * to another page after the lookup is not mistaken for it. Whatever is read from read.page has to be
+	 * confirmed with validate() before it is used.
+	 * Pages modified through raw pointers from the readPage() overload returning one are not covered;
+	 * writers have to use page handles.
+	 * Only the frame version is read atomically. The hash table, the valid bits and the frame descriptors are
+	 * plain loads, so calls which change them, any call which pins, evicts, flushes or disposes of a page, must
+	 * not run at the same time as this one; the version only protects against changes to the page itself.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file to be read
+	 * @param read  	Frame, version and page are returned via this reference
+	 * @return  			False if the page is not in the buffer pool or is being changed; pin it instead
+	 */
+  bool readOptimistic(File* file, const PageId pageNo, OptimisticRead& read);
+
+	/**
+	 * Returns true if the frame of an optimistic read has not changed since the read started.
+	 *
+	 * @param read  	Optimistic read returned by readOptimistic()
+	 */
+  bool validate(const OptimisticRead& read) const
+  {
+		std::atomic_thread_fence(std::memory_order_acquire);
+		return frameVersions[read.frameNo].load(std::memory_order_relaxed) == read.version;
+  }
+
+	/**
+	 * Writes out all dirty pages of the file to disk, followed by the file header if the file keeps it in memory.
+	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
+	 * Otherwise Error returned.
+	 *
+	 * @param file   	File object
+   * @throws  PagePinnedException If any page of the file is pinned in the buffer pool 
+   * @throws BadBufferException If any frame allocated to the file is found to be invalid
+	 */
+  void flushFile(const File* file);
+
+	/**
+	 * Makes all changes made through the buffer pool durable. The dirty pages of all files are written as one
+	 * batch and stay in the pool as clean pages. Then the headers are written and the files synced, for the
+	 * files with pages in the pool, for every file written since the last checkpoint, including pages
+	 * written back on eviction or by flushFile(), and for every open file whose cached header has changed.
+	 * Unlike flushFile(), pages may be pinned; a pinned page is written as it is at the time of the call.
+	 *
+	 * @return  			false if a file could not be synced
+	 */
+  bool checkpoint();
+
+	/**
+	 * Delete page from file and also from buffer pool if present.
+	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
+	 * Pins held on the page by the calling thread are dropped with it.
+	 *
+	 * @param file   	File object
+	 * @param PageNo  Page number
+	 */
+  void disposePage(File* file, const PageId PageNo);
+
+	/**
+   * Print member variable values. 
+	 */
+  void  printSelf();
+
+	/**
+   * Get buffer pool usage statistics
+	 */
+  BufStats & getBufStats()
+  {
+		return bufStats;
+  }
+
+	/**
+   * Returns a copy of all buffer pool usage statistics, including the per file breakdown and latency histograms
+	 */
+  BufStatsSnapshot getStatsSnapshot() const;
+
+	/**
+   * Prints all buffer pool usage statistics in human readable form.
+	 *
+	 * @param out	Stream to print to
+	 */
+  void dumpStats(std::ostream& out) const;
+
+	/**
+   * Clear buffer pool usage statistics
+	 */
+  void clearBufStats();
 };
 
 }
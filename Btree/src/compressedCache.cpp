@@ -0,0 +1,205 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstring>
+#include "compressedCache.h"
+
+namespace badgerdb {
+
+// The codec follows the LZ4 block layout: every sequence starts with a token whose high nibble is the number of
+// literals and whose low nibble is the match length less MIN_MATCH, 15 meaning that further length bytes follow.
+// The literals come next, then the two byte offset of the match. The last sequence only has literals.
+static const std::size_t MIN_MATCH = 4;
+static const int HASH_BITS = 12;
+
+static std::uint32_t load32(const char* p)
+{
+  std::uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static void putLength(std::string& out, std::size_t len)
+{
+  while (len >= 255)
+  {
+    out.push_back((char) 255);
+    len -= 255;
+  }
+  out.push_back((char) len);
+}
+
+static bool getLength(const unsigned char*& ip, const unsigned char* end, std::size_t& len)
+{
+  unsigned char b;
+  do
+  {
+    if (ip == end)
+      return false;
+    b = *ip++;
+    len += b;
+  } while (b == 255);
+  return true;
+}
+
+static void putSequence(std::string& out, const char* literals, const std::size_t numLiterals,
+                        const std::size_t offset, const std::size_t matchLen)
+{
+  std::size_t litCode = numLiterals < 15 ? numLiterals : 15;
+  std::size_t matchCode = 0;
+  if (matchLen > 0)
+    matchCode = matchLen - MIN_MATCH < 15 ? matchLen - MIN_MATCH : 15;
+  out.push_back((char) ((litCode << 4) | matchCode));
+  if (litCode == 15)
+    putLength(out, numLiterals - 15);
+  out.append(literals, numLiterals);
+  if (matchLen == 0)
+    return;
+  out.push_back((char) (offset & 0xff));
+  out.push_back((char) (offset >> 8));
+  if (matchCode == 15)
+    putLength(out, matchLen - MIN_MATCH - 15);
+}
+
+void CompressedCache::compress(const char* src, const std::size_t size, std::string& out)
+{
+  // positions of earlier 4 byte sequences by hash, -1 when unused
+  int table[1 << HASH_BITS];
+  for (int i = 0; i < (1 << HASH_BITS); i++)
+    table[i] = -1;
+
+  out.clear();
+  std::size_t anchor = 0;
+  std::size_t i = 0;
+  while (i + MIN_MATCH <= size)
+  {
+    std::uint32_t seq = load32(src + i);
+    std::uint32_t h = (seq * 2654435761u) >> (32 - HASH_BITS);
+    int candidate = table[h];
+    table[h] = (int) i;
+    if (candidate < 0 || load32(src + candidate) != seq)
+    {
+      i++;
+      continue;
+    }
+
+    std::size_t len = MIN_MATCH;
+    while (i + len < size && src[candidate + len] == src[i + len])
+      len++;
+    putSequence(out, src + anchor, i - anchor, i - candidate, len);
+    i += len;
+    anchor = i;
+  }
+  putSequence(out, src + anchor, size - anchor, 0, 0);
+}
+
+bool CompressedCache::decompress(const char* src, const std::size_t srcSize, char* dst, const std::size_t dstSize)
+{
+  const unsigned char* ip = reinterpret_cast<const unsigned char*>(src);
+  const unsigned char* end = ip + srcSize;
+  std::size_t op = 0;
+  while (ip < end)
+  {
+    unsigned char token = *ip++;
+    std::size_t numLiterals = token >> 4;
+    if (numLiterals == 15 && !getLength(ip, end, numLiterals))
+      return false;
+    if (numLiterals > (std::size_t) (end - ip) || numLiterals > dstSize - op)
+      return false;
+    std::memcpy(dst + op, ip, numLiterals);
+    ip += numLiterals;
+    op += numLiterals;
+    if (ip == end)
+      break;
+
+    if (end - ip < 2)
+      return false;
+    std::size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    std::size_t matchLen = token & 15;
+    if (matchLen == 15 && !getLength(ip, end, matchLen))
+      return false;
+    matchLen += MIN_MATCH;
+    if (offset == 0 || offset > op || matchLen > dstSize - op)
+      return false;
+    // copy byte by byte since the match may overlap the bytes it produces
+    for (std::size_t k = 0; k < matchLen; k++, op++)
+      dst[op] = dst[op - offset];
+  }
+  return op == dstSize;
+}
+
+CompressedCache::CompressedCache(const std::size_t capacityBytes)
+	: capacity(capacityBytes), used(0)
+{
+}
+
+void CompressedCache::setCapacity(const std::size_t capacityBytes)
+{
+  capacity = capacityBytes;
+  makeRoom(0);
+}
+
+void CompressedCache::remove(EntryMap::iterator it)
+{
+  used -= it->second.data.size();
+  lruList.erase(it->second.lru);
+  entries.erase(it);
+}
+
+void CompressedCache::makeRoom(const std::size_t bytes)
+{
+  while (!lruList.empty() && used + bytes > capacity)
+    remove(entries.find(lruList.front()));
+}
+
+bool CompressedCache::insert(const File* file, const PageId pageNo, const Page& page)
+{
+  erase(file, pageNo);
+  if (capacity == 0)
+    return false;
+
+  std::string data;
+  compress(reinterpret_cast<const char*>(&page), Page::SIZE, data);
+  if (data.size() > Page::SIZE / 2 || data.size() > capacity)
+    return false;
+  makeRoom(data.size());
+
+  std::pair<const File*, PageId> key(file, pageNo);
+  lruList.push_back(key);
+  Entry& entry = entries[key];
+  entry.data.swap(data);
+  entry.lru = --lruList.end();
+  used += entry.data.size();
+  return true;
+}
+
+bool CompressedCache::take(const File* file, const PageId pageNo, Page& page)
+{
+  EntryMap::iterator it = entries.find(std::make_pair(file, pageNo));
+  if (it == entries.end())
+    return false;
+  bool ok = decompress(it->second.data.data(), it->second.data.size(), reinterpret_cast<char*>(&page), Page::SIZE);
+  remove(it);
+  return ok;
+}
+
+void CompressedCache::erase(const File* file, const PageId pageNo)
+{
+  EntryMap::iterator it = entries.find(std::make_pair(file, pageNo));
+  if (it != entries.end())
+    remove(it);
+}
+
+void CompressedCache::eraseFile(const File* file)
+{
+  EntryMap::iterator it = entries.lower_bound(std::make_pair(file, (PageId) 0));
+  while (it != entries.end() && it->first.first == file)
+    remove(it++);
+}
+
+}
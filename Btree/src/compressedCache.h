@@ -0,0 +1,153 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <string>
+#include <utility>
+#include "file.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+* @brief Second tier of the buffer pool holding compressed copies of clean pages evicted from it
+*
+* Pages are compressed with a small LZ style codec. Index pages compress well since the unused parts of their
+* key and page number arrays are zero filled, so the tier holds several times more pages than the same memory
+* would as frames. When the tier is full the least recently stored pages are dropped first.
+*
+* @warning This class is not threadsafe.
+*/
+class CompressedCache
+{
+ private:
+	/**
+	 * Compressed copy of one page
+	 */
+  struct Entry
+  {
+    std::string data;
+    std::list<std::pair<const File*, PageId> >::iterator lru;
+  };
+
+  typedef std::map<std::pair<const File*, PageId>, Entry> EntryMap;
+
+	/**
+	 * Maximum number of compressed bytes held
+	 */
+  std::size_t capacity;
+
+	/**
+	 * Number of compressed bytes currently held
+	 */
+  std::size_t used;
+
+	/**
+	 * Compressed pages by (file, page number)
+	 */
+  EntryMap entries;
+
+	/**
+	 * Keys of the compressed pages, least recently stored first
+	 */
+  std::list<std::pair<const File*, PageId> > lruList;
+
+	/**
+	 * Removes the given entry and releases its bytes
+	 */
+  void remove(EntryMap::iterator it);
+
+	/**
+	 * Drops least recently stored pages until the given number of bytes fits
+	 */
+  void makeRoom(const std::size_t bytes);
+
+ public:
+	/**
+   * Constructor of CompressedCache class
+	 *
+	 * @param capacityBytes	Maximum number of compressed bytes held. A capacity of 0 disables the tier.
+	 */
+  explicit CompressedCache(const std::size_t capacityBytes);
+
+	/**
+   * Changes the maximum number of compressed bytes held, dropping pages if needed.
+	 */
+  void setCapacity(const std::size_t capacityBytes);
+
+	/**
+   * Returns the maximum number of compressed bytes held.
+	 */
+  std::size_t getCapacity() const { return capacity; }
+
+	/**
+   * Returns the number of compressed bytes currently held.
+	 */
+  std::size_t getUsed() const { return used; }
+
+	/**
+   * Returns the number of pages currently held.
+	 */
+  std::size_t size() const { return entries.size(); }
+
+	/**
+	 * Stores a compressed copy of a page, replacing any older copy. Pages which do not compress to at most
+	 * half of their size are not worth the decompression on a hit and are not stored.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param page  	Page contents, which must match the page on disk
+	 * @return  			true if the page was stored
+	 */
+  bool insert(const File* file, const PageId pageNo, const Page& page);
+
+	/**
+	 * Moves a page out of the tier. On success the page is decompressed into the given page and its compressed
+	 * copy is dropped, since the page is about to be held by a frame.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param page  	Page to decompress into
+	 * @return  			true if the page was held by the tier
+	 */
+  bool take(const File* file, const PageId pageNo, Page& page);
+
+	/**
+	 * Drops the copy of a page, if any.
+	 */
+  void erase(const File* file, const PageId pageNo);
+
+	/**
+	 * Drops the copies of all pages of a file.
+	 */
+  void eraseFile(const File* file);
+
+	/**
+	 * Compresses a block of bytes.
+	 *
+	 * @param src   	Bytes to compress
+	 * @param size  	Number of bytes, at most 65535
+	 * @param out   	Receives the compressed bytes
+	 */
+  static void compress(const char* src, const std::size_t size, std::string& out);
+
+	/**
+	 * Decompresses a block compressed with compress().
+	 *
+	 * @param src   	Compressed bytes
+	 * @param srcSize	Number of compressed bytes
+	 * @param dst   	Receives the decompressed bytes
+	 * @param dstSize	Number of bytes the block decompresses to
+	 * @return  			false if the compressed bytes are malformed
+	 */
+  static bool decompress(const char* src, const std::size_t srcSize, char* dst, const std::size_t dstSize);
+};
+
+}
@@ -0,0 +1,55 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the operating system fails a read or
+ *        write on a file.
+ */
+class FileIOException : public BadgerDbException {
+ public:
+  /**
+   * Constructs a file I/O exception for the given operation.
+   *
+   * @param operation   Name of the operation that failed, "read" or "write".
+   * @param offset      Position in the file of the bytes not transferred.
+   * @param error       Error number reported by the operating system.
+   */
+  FileIOException(const std::string& operation, const std::streamoff offset,
+                  const int error);
+
+  /**
+   * Returns the position in the file at which the operation failed.
+   */
+  virtual std::streamoff offset() const { return offset_; }
+
+  /**
+   * Returns the error number reported by the operating system.
+   */
+  virtual int error() const { return error_; }
+
+ protected:
+  /**
+   * Position in the file at which the operation failed.
+   */
+  const std::streamoff offset_;
+
+  /**
+   * Error number reported by the operating system.
+   */
+  const int error_;
+};
+
+}
@@ -7,24 +7,33 @@
 
 #include "file.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
+#include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_page_exception.h"
 #include "file_iterator.h"
 #include "page.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
-File::CountMap File::open_counts_;
+std::vector<File::OpenFile> File::open_files_;
+std::vector<FileId> File::free_ids_;
+File::IdMap File::open_ids_;
+std::mutex File::open_mutex_;
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -40,7 +49,21 @@ bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
-  return open_counts_.find(filename) != open_counts_.end();
+  std::lock_guard<std::mutex> lock(open_mutex_);
+  return open_ids_.find(filename) != open_ids_.end();
+}
+
+std::vector<std::string> File::dirtyHeaderFiles() {
+  std::lock_guard<std::mutex> lock(open_mutex_);
+  std::vector<std::string> names;
+  for (IdMap::const_iterator it = open_ids_.begin(); it != open_ids_.end();
+       ++it) {
+    const std::shared_ptr<CachedHeader>& header = open_files_[it->second].header;
+    if (header && (header->dirty || header->free_space_dirty)) {
+      names.push_back(it->first);
+    }
+  }
+  return names;
 }
 
 bool File::exists(const std::string& filename) {
@@ -64,87 +87,234 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
-  openIfNeeded(create_new);
+File::File(const std::string& name, const bool create_new,
+           const FileBackend backend) : filename_(name), id_(0) {
+  openIfNeeded(create_new, backend);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         0 /* last_used_page */, 0 /* first_map_page */};
     writeHeader(header);
   }
+  // from here on the header is read and updated in memory, so that reading a
+  // page costs no extra I/O to check its number against num_pages
+  cacheHeader();
 }
 
-void File::openIfNeeded(const bool create_new) {
-  if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
-    ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+void File::openIfNeeded(const bool create_new, const FileBackend backend) {
+  std::lock_guard<std::mutex> lock(open_mutex_);
+  IdMap::iterator it = open_ids_.find(filename_);
+  if (it != open_ids_.end()) {	//exists an entry already
+    id_ = it->second;
+    ++open_files_[id_].count;
+    io_ = open_files_[id_].io;
   } else {
-    std::ios_base::openmode mode =
-        std::fstream::in | std::fstream::out | std::fstream::binary;
     const bool already_exists = exists(filename_);
     if (create_new) {
       // Error if we try to overwrite an existing file.
       if (already_exists) {
         throw FileExistsException(filename_);
       }
-      // New files have to be truncated on open.
-      mode = mode | std::fstream::trunc;
     } else {
       // Error if we try to open a file that doesn't exist.
       if (!already_exists) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
-    open_counts_[filename_] = 1;
+    io_.reset(FileIO::open(filename_, create_new, backend));
+    if (!io_) {
+      throw FileNotFoundException(filename_);
+    }
+    if (free_ids_.empty()) {
+      id_ = open_files_.size();
+      open_files_.push_back(OpenFile());
+    } else {
+      id_ = free_ids_.back();
+      free_ids_.pop_back();
+    }
+    open_files_[id_].io = io_;
+    open_files_[id_].count = 1;
+    open_ids_[filename_] = id_;
   }
 }
 
 void File::close() {
+  std::lock_guard<std::mutex> lock(open_mutex_);
+  if (!io_) {
+    return;
+  }
+  OpenFile& entry = open_files_[id_];
+  // the last user of the file takes the cached header to disk
+  if (header_cache_ && entry.count == 1) {
+    flushHeader();
+  }
+  header_cache_.reset();
 
-    if(open_counts_[filename_] > 0)
-  {
-      --open_counts_[filename_];
+  --entry.count;
+  io_.reset();
+	assert(entry.count >= 0);
+
+  if (entry.count == 0) {
+    entry.io.reset();
+    entry.header.reset();
+    open_ids_.erase(filename_);
+    free_ids_.push_back(id_);
+  }
+}
+
+const Page* File::mappedPage(const PageId page_number) const {
+  if (page_number == Page::INVALID_NUMBER ||
+      page_number >= readHeader().num_pages) {
+    return NULL;
   }
+  return reinterpret_cast<const Page*>(
+      io_->mappedAddress(pagePosition(page_number), Page::SIZE));
+}
 
-  stream_.reset();
-	assert(open_counts_[filename_] >= 0);
+void File::cacheHeader() {
+  std::lock_guard<std::mutex> lock(open_mutex_);
+  OpenFile& entry = open_files_[id_];
+  if (entry.header) {
+    header_cache_ = entry.header;
+    return;
+  }
 
-  if (open_counts_[filename_] == 0) {
-      open_streams_.erase(filename_);
-    open_counts_.erase(filename_);
+  std::shared_ptr<CachedHeader> cache(new CachedHeader);
+  cache->header = readHeader();
+  // space past the last page may have been preallocated before the file was
+  // last closed
+  const std::streamoff size = io_->size();
+  cache->reserved_pages = size < (std::streamoff) (2 * Page::SIZE) ? 1 :
+      (PageId) (size / Page::SIZE);
+  if (cache->reserved_pages < cache->header.num_pages) {
+    cache->reserved_pages = cache->header.num_pages;
   }
+  cache->dirty = false;
+  cache->used_pages_loaded = false;
+  cache->free_space_loaded = false;
+  cache->free_space_dirty = false;
+  cache->free_pages_loaded = false;
+
+  header_cache_ = cache;
+  entry.header = cache;
+}
+
+void File::flushHeader() const {
+  if (!header_cache_) {
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+  writeCachedHeader(*io_, *header_cache_);
+}
+
+void File::writeCachedHeader(FileIO& io, CachedHeader& cache) {
+  if (cache.free_space_dirty) {
+    writeFreeSpaceMap(io, cache);
+  } else if (cache.dirty) {
+    io.write(reinterpret_cast<const char*>(&cache.header), sizeof(FileHeader),
+             0 /* pos */);
+    cache.dirty = false;
+  }
+}
+
+// Packs free space map entries into 4 bits each, into zeroed bytes.
+static void packFreeSpace(const std::vector<std::uint8_t>& free_space,
+                          const std::size_t first, const std::size_t count,
+                          char* bytes) {
+  for (std::size_t i = 0; i < count && first + i < free_space.size(); ++i) {
+    bytes[i / 2] |= free_space[first + i] << (i % 2 * 4);
+  }
+}
+
+static void unpackFreeSpace(const char* bytes, const std::size_t first,
+                            const std::size_t count,
+                            std::vector<std::uint8_t>& free_space) {
+  for (std::size_t i = 0; i < count && first + i < free_space.size(); ++i) {
+    free_space[first + i] = (bytes[i / 2] >> (i % 2 * 4)) & 0xf;
+  }
+}
+
+void File::writeFreeSpaceMap(FileIO& io, CachedHeader& cache) {
+  // pages for the map are added at the end of the file, which adds entries to
+  // the map in turn
+  while (cache.header.num_pages >
+         HEADER_MAP_ENTRIES + cache.map_pages.size() * MAP_PAGE_ENTRIES) {
+    const PageId map_page_number = cache.header.num_pages++;
+    if (cache.map_pages.empty()) {
+      cache.header.first_map_page = map_page_number;
+    }
+    cache.map_pages.push_back(map_page_number);
+  }
+  cache.free_space.resize(cache.header.num_pages, 0);
+
+  // the header page goes to disk in one write; the page is aligned for the
+  // DIRECT backend
+  std::unique_ptr<Page> page(new Page);
+  char* bytes = reinterpret_cast<char*>(page.get());
+  std::memset(bytes, 0, Page::SIZE);
+  std::memcpy(bytes, &cache.header, sizeof(FileHeader));
+  packFreeSpace(cache.free_space, 0, HEADER_MAP_ENTRIES,
+                bytes + sizeof(FileHeader));
+  io.write(bytes, Page::SIZE, 0 /* pos */);
+
+  // map pages are neither used nor free, so they are never handed out
+  for (std::size_t i = 0; i < cache.map_pages.size(); ++i) {
+    page->initialize();
+    page->set_next_page_number(i + 1 < cache.map_pages.size() ?
+                               cache.map_pages[i + 1] : Page::INVALID_NUMBER);
+    packFreeSpace(cache.free_space, HEADER_MAP_ENTRIES + i * MAP_PAGE_ENTRIES,
+                  MAP_PAGE_ENTRIES, &page->data_[0]);
+    io.write(bytes, Page::SIZE, pagePosition(cache.map_pages[i]));
+  }
+  cache.free_space_dirty = false;
+  cache.dirty = false;
+}
+
+bool File::sync() const {
+  flushHeader();
+  return io_->sync();
 }
 
 FileHeader File::readHeader() const {
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+  if (header_cache_) {
+    return header_cache_->header;
+  }
   FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+  io_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader), 0 /* pos */);
   return header;
 }
 
 void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+  if (header_cache_) {
+    header_cache_->header = header;
+    header_cache_->dirty = true;
+    return;
+  }
+  io_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader),
+             0 /* pos */);
 }
 
 
 
 
 
-PageFile PageFile::create(const std::string& filename) {
-  return PageFile(filename, true /* create_new */);
+PageFile PageFile::create(const std::string& filename,
+                          const FileBackend backend) {
+  return PageFile(filename, true /* create_new */, backend);
 }
 
-PageFile PageFile::open(const std::string& filename) {
-  return PageFile(filename, false /* create_new */);
+PageFile PageFile::open(const std::string& filename,
+                        const FileBackend backend) {
+  return PageFile(filename, false /* create_new */, backend);
 }
 
-PageFile::PageFile(const std::string& name, const bool create_new)
-: File(name, create_new)
+PageFile::PageFile(const std::string& name, const bool create_new,
+                   const FileBackend backend)
+: File(name, create_new, backend)
 {
 }
 
@@ -162,42 +332,65 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
   openIfNeeded(false /* create_new */);
+  cacheHeader();
   return *this;
 }
 
+bool File::syncFile(const std::string& filename) {
+  std::shared_ptr<FileIO> io;
+  std::shared_ptr<CachedHeader> header;
+  {
+    std::lock_guard<std::mutex> lock(open_mutex_);
+    IdMap::const_iterator it = open_ids_.find(filename);
+    if (it != open_ids_.end()) {
+      io = open_files_[it->second].io;
+      header = open_files_[it->second].header;
+    }
+  }
+  if (io) {
+    if (header) {
+      std::lock_guard<std::recursive_mutex> lock(io->structureMutex());
+      writeCachedHeader(*io, *header);
+    }
+    return io->sync();
+  }
+
+  // a closed file had its header written when it was closed, so only its
+  // data is left to sync; that needs no File object of either kind
+  const int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return errno == ENOENT;
+  }
+  const bool synced = fsync(fd) == 0;
+  ::close(fd);
+  return synced;
+}
+
 Page PageFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
   Page new_page;
-  Page existing_page;
+  allocatePage(new_page_number, new_page);
+  return new_page;
+}
+
+void PageFile::allocatePage(PageId &new_page_number, Page& new_page) {
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+  FileHeader header = readHeader();
+  // the page before the new one in the used list, if any
+  PageId previous_page_number = Page::INVALID_NUMBER;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
+    readPage(header.first_free_page, true /* allow_free */, new_page);
     new_page.set_page_number(header.first_free_page);
 		new_page_number = new_page.page_number();
     header.first_free_page = new_page.next_page_number();
     --header.num_free_pages;
 
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
-    } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
+    // the used list is kept in page number order, so the reused page goes
+    // after the highest numbered used page below it
+    loadUsedPages();
+    previous_page_number = previousUsedPage(new_page_number);
+    if (previous_page_number == Page::INVALID_NUMBER) {
+      new_page.set_next_page_number(header.first_used_page);
+      header.first_used_page = new_page_number;
     }
 
     assert((header.num_free_pages == 0) ==
@@ -205,62 +398,71 @@ Page PageFile::allocatePage(PageId &new_page_number) {
   }
 	else
 	{
+    new_page.initialize();
     new_page.set_page_number(header.num_pages);
 		new_page_number = new_page.page_number();
 
+    // new pages have the highest number, so they go at the tail
     if (header.first_used_page == Page::INVALID_NUMBER)
 		{
-      header.first_used_page = new_page.page_number();
+      header.first_used_page = new_page_number;
     }
 		else
 		{
-      // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
+      previous_page_number = header.last_used_page;
     }
     ++header.num_pages;
   }
-  writePage(new_page_number, new_page.header_, new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
-    // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page.header_, existing_page);
+
+  if (previous_page_number != Page::INVALID_NUMBER) {
+    PageHeader previous_header = readPageHeader(previous_page_number);
+    new_page.set_next_page_number(previous_header.next_page_number);
+    previous_header.next_page_number = new_page_number;
+    writePageHeader(previous_page_number, previous_header);
+  }
+  if (new_page.next_page_number() == Page::INVALID_NUMBER) {
+    header.last_used_page = new_page_number;
   }
+  writePage(new_page_number, new_page.header_, new_page);
+  setPageUsed(new_page_number, true);
   writeHeader(header);
-
-  return new_page;
+  setFreeSpace(new_page_number, freeSpaceCategory(new_page));
 }
 
 Page PageFile::readPage(const PageId page_number) const {
+  Page page;
+  readPage(page_number, page);
+  return page;
+}
+
+void PageFile::readPage(const PageId page_number, Page& page) const {
   FileHeader header = readHeader();
 
 	if (page_number >= header.num_pages)
 	{
 		throw InvalidPageException(page_number, filename_);
 	}
-	return readPage(page_number, false /* allow_free */);
+	readPage(page_number, false /* allow_free */, page);
 }
 
 Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
   Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(reinterpret_cast<char*>(&page.data_[0]), Page::DATA_SIZE);
+  readPage(page_number, allow_free, page);
+  return page;
+}
+
+void PageFile::readPage(const PageId page_number, const bool allow_free,
+                        Page& page) const {
+  io_->read(reinterpret_cast<char*>(&page), Page::SIZE,
+            pagePosition(page_number));
   if (!allow_free && !page.isUsed()) {
     throw InvalidPageException(page_number, filename_);
   }
-
-  return page;
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
+	// the page must not be deleted or relinked between reading and writing its header
+	std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
 	PageHeader header = readPageHeader(new_page_number);
 	if (header.current_page_number == Page::INVALID_NUMBER)
 	{
@@ -274,37 +476,321 @@ void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 	header = new_page.header_;
 	header.next_page_number = next_page_number;
 	writePage(new_page_number, header, new_page);
+	setFreeSpace(new_page_number, freeSpaceCategory(new_page));
+}
+
+void PageFile::writePageHeader(const PageId page_number,
+                               const PageHeader& header) {
+  io_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader),
+             pagePosition(page_number));
+}
+
+void PageFile::loadUsedPages() {
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+  if (header_cache_->used_pages_loaded) {
+    return;
+  }
+  const FileHeader header = readHeader();
+  std::vector<std::uint64_t>& used_pages = header_cache_->used_pages;
+  used_pages.assign(header.num_pages / 64 + 1, 0);
+  // only the page headers are needed to follow the list
+  for (PageId page_number = header.first_used_page;
+       page_number != Page::INVALID_NUMBER;
+       page_number = readPageHeader(page_number).next_page_number) {
+    used_pages[page_number / 64] |= std::uint64_t(1) << (page_number % 64);
+  }
+  header_cache_->used_pages_loaded = true;
+}
+
+void PageFile::setPageUsed(const PageId page_number, const bool used) {
+  if (!header_cache_->used_pages_loaded) {
+    return;
+  }
+  std::vector<std::uint64_t>& used_pages = header_cache_->used_pages;
+  if (page_number / 64 >= used_pages.size()) {
+    used_pages.resize(page_number / 64 + 1, 0);
+  }
+  const std::uint64_t bit = std::uint64_t(1) << (page_number % 64);
+  if (used) {
+    used_pages[page_number / 64] |= bit;
+  } else {
+    used_pages[page_number / 64] &= ~bit;
+  }
+}
+
+PageId PageFile::previousUsedPage(const PageId page_number) const {
+  const std::vector<std::uint64_t>& used_pages = header_cache_->used_pages;
+  if (page_number <= 1) {
+    return Page::INVALID_NUMBER;
+  }
+  std::size_t word = (page_number - 1) / 64;
+  if (word >= used_pages.size()) {
+    word = used_pages.size() - 1;
+    if (used_pages[word] != 0) {
+      return word * 64 + 63 - __builtin_clzll(used_pages[word]);
+    }
+  } else {
+    // the bits of the word below the page
+    const unsigned below = (page_number - 1) % 64 + 1;
+    std::uint64_t bits = used_pages[word];
+    if (below < 64) {
+      bits &= (std::uint64_t(1) << below) - 1;
+    }
+    if (bits != 0) {
+      return word * 64 + 63 - __builtin_clzll(bits);
+    }
+  }
+  while (word > 0) {
+    --word;
+    if (used_pages[word] != 0) {
+      return word * 64 + 63 - __builtin_clzll(used_pages[word]);
+    }
+  }
+  return Page::INVALID_NUMBER;
+}
+
+// Bytes of free space per free space category.
+static const std::size_t FREE_SPACE_STEP =
+    Page::DATA_SIZE / (PageFile::FREE_SPACE_CATEGORIES - 1);
+
+void PageFile::loadFreeSpaceMap() {
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+  CachedHeader& cache = *header_cache_;
+  if (cache.free_space_loaded) {
+    return;
+  }
+  const FileHeader header = readHeader();
+  cache.free_space.assign(header.num_pages, 0);
+  cache.map_pages.clear();
+  cache.free_space_hints.assign(FREE_SPACE_CATEGORIES, 1);
+
+  std::unique_ptr<Page> page(new Page);
+  char* bytes = reinterpret_cast<char*>(page.get());
+  io_->read(bytes, Page::SIZE, 0 /* pos */);
+  unpackFreeSpace(bytes + sizeof(FileHeader), 0, HEADER_MAP_ENTRIES,
+                  cache.free_space);
+  for (PageId map_page_number = header.first_map_page;
+       map_page_number != Page::INVALID_NUMBER;
+       map_page_number = page->next_page_number()) {
+    readPage(map_page_number, true /* allow_free */, *page);
+    unpackFreeSpace(&page->data_[0],
+                    HEADER_MAP_ENTRIES + cache.map_pages.size() * MAP_PAGE_ENTRIES,
+                    MAP_PAGE_ENTRIES, cache.free_space);
+    cache.map_pages.push_back(map_page_number);
+  }
+  cache.free_space_loaded = true;
+}
+
+void PageFile::setFreeSpace(const PageId page_number,
+                            const std::uint8_t category) {
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+  loadFreeSpaceMap();
+  CachedHeader& cache = *header_cache_;
+  if (page_number >= cache.free_space.size()) {
+    cache.free_space.resize(page_number + 1, 0);
+  }
+  if (cache.free_space[page_number] == category) {
+    return;
+  }
+  cache.free_space[page_number] = category;
+  cache.free_space_dirty = true;
+  for (std::uint8_t c = 0; c <= category; ++c) {
+    if (cache.free_space_hints[c] > page_number) {
+      cache.free_space_hints[c] = page_number;
+    }
+  }
+}
+
+std::uint8_t PageFile::freeSpaceCategory(const Page& page) {
+  if (!page.isUsed()) {
+    return 0;
+  }
+  const std::size_t category = page.getFreeSpace() / FREE_SPACE_STEP;
+  return category < FREE_SPACE_CATEGORIES ? category : FREE_SPACE_CATEGORIES - 1;
+}
+
+PageId PageFile::findFreeSpace(const std::uint8_t category, const PageId from) {
+  CachedHeader& cache = *header_cache_;
+  PageId& hint = cache.free_space_hints[category];
+  PageId page_number = from > hint ? from : hint;
+  while (page_number < cache.free_space.size() &&
+         cache.free_space[page_number] < category) {
+    ++page_number;
+  }
+  // the pages skipped have less free space, so later searches start here
+  if (from <= hint) {
+    hint = page_number;
+  }
+  return page_number < cache.free_space.size() ? page_number
+                                               : Page::INVALID_NUMBER;
+}
+
+RecordId PageFile::insertRecord(const std::string& record_data) {
+  if (record_data.length() > Page::MAX_RECORD_SIZE) {
+    throw InsufficientSpaceException(Page::INVALID_NUMBER,
+                                     record_data.length(), Page::DATA_SIZE);
+  }
+
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+  Page page;
+
+  for (PageId page_number = findPageWithSpace(record_data.length(), 1);
+       page_number != Page::INVALID_NUMBER;
+       page_number = findPageWithSpace(record_data.length(), page_number + 1)) {
+    readPage(page_number, true /* allow_free */, page);
+    if (page.isUsed() && page.hasSpaceForRecord(record_data)) {
+      const RecordId record_id = page.insertRecord(record_data);
+      writePage(page_number, page);
+      return record_id;
+    }
+    updateFreeSpace(page_number, page);
+  }
+
+  PageId page_number;
+  allocatePage(page_number, page);
+  const RecordId record_id = page.insertRecord(record_data);
+  writePage(page_number, page);
+  return record_id;
+}
+
+PageId PageFile::findPageWithSpace(const std::size_t record_length,
+                                  const PageId from) {
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+  loadFreeSpaceMap();
+  // a page in the category needed has room for the record and a new slot,
+  // unless the map is behind the page
+  std::size_t category = (record_length + sizeof(PageSlot) +
+                          FREE_SPACE_STEP - 1) / FREE_SPACE_STEP;
+  if (category >= FREE_SPACE_CATEGORIES) {
+    category = FREE_SPACE_CATEGORIES - 1;
+  }
+  return findFreeSpace(category, from);
+}
+
+void PageFile::updateFreeSpace(const PageId page_number, const Page& page) {
+  setFreeSpace(page_number, freeSpaceCategory(page));
+}
+
+std::size_t PageFile::readPages(IoEngine& engine, const PageId* page_numbers,
+                                Page* const* pages,
+                                const std::size_t count) const {
+  const FileHeader header = readHeader();
+  std::size_t num_read = 0;
+  while (num_read < count && page_numbers[num_read] != Page::INVALID_NUMBER &&
+         page_numbers[num_read] < header.num_pages) {
+    engine.read(*io_, reinterpret_cast<char*>(pages[num_read]), Page::SIZE,
+                pagePosition(page_numbers[num_read]));
+    ++num_read;
+  }
+  engine.wait();
+
+  for (std::size_t i = 0; i < num_read; ++i) {
+    if (!pages[i]->isUsed()) {
+      return i;
+    }
+  }
+  return num_read;
+}
+
+void PageFile::writePages(IoEngine& engine, const PageId* page_numbers,
+                          const Page* const* pages, const std::size_t count) {
+  // as in writePage(), the next page pointers on disk are kept
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+  std::vector<PageHeader> headers(count);
+  for (std::size_t i = 0; i < count; ++i) {
+    engine.read(*io_, reinterpret_cast<char*>(&headers[i]), sizeof(PageHeader),
+                pagePosition(page_numbers[i]));
+  }
+  engine.wait();
+  for (std::size_t i = 0; i < count; ++i) {
+    if (headers[i].current_page_number == Page::INVALID_NUMBER) {
+      throw InvalidPageException(page_numbers[i], filename_);
+    }
+  }
+
+  // a page whose next page pointer is still the one on disk is written as it
+  // is, keeping it aligned for the DIRECT backend; the others are assembled
+  std::vector<std::unique_ptr<Page> > assembled;
+  for (std::size_t i = 0; i < count; ++i) {
+    const Page* page = pages[i];
+    if (page->header_.next_page_number != headers[i].next_page_number) {
+      assembled.emplace_back(new Page(*page));
+      assembled.back()->header_.next_page_number = headers[i].next_page_number;
+      page = assembled.back().get();
+    }
+    engine.write(*io_, reinterpret_cast<const char*>(page), Page::SIZE,
+                 pagePosition(page_numbers[i]));
+  }
+  engine.wait();
+  for (std::size_t i = 0; i < count; ++i) {
+    setFreeSpace(page_numbers[i], freeSpaceCategory(*pages[i]));
+  }
 }
 
 void PageFile::deletePage(const PageId page_number) {
+  deletePages(&page_number, 1);
+}
+
+void PageFile::deletePages(const PageId* page_numbers,
+                           const std::size_t count) {
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
   FileHeader header = readHeader();
 
-  Page existing_page = readPage(page_number);
-  Page previous_page;
-  // If this page is the head of the used list, update the header to point to
-  // the next page in line.
-  if (page_number == header.first_used_page) {
-    header.first_used_page = existing_page.next_page_number();
-  } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
+  std::vector<PageId> deleted(page_numbers, page_numbers + count);
+  std::sort(deleted.begin(), deleted.end());
+  deleted.erase(std::unique(deleted.begin(), deleted.end()), deleted.end());
+  std::vector<PageHeader> page_headers(deleted.size());
+  for (std::size_t i = 0; i < deleted.size(); ++i) {
+    if (deleted[i] == Page::INVALID_NUMBER || deleted[i] >= header.num_pages) {
+      throw InvalidPageException(deleted[i], filename_);
+    }
+    page_headers[i] = readPageHeader(deleted[i]);
+    if (page_headers[i].current_page_number == Page::INVALID_NUMBER) {
+      throw InvalidPageException(deleted[i], filename_);
+    }
+  }
+
+  loadUsedPages();
+  for (std::size_t i = 0; i < deleted.size(); ++i) {
+    setPageUsed(deleted[i], false);
+  }
+
+  // The used list is in page number order, so a run of deleted pages follows
+  // each other in the list, and the page before the run is the highest
+  // numbered page still used below it.
+  std::size_t run_start = 0;
+  for (std::size_t i = 0; i < deleted.size(); ++i) {
+    const PageId next_page_number = page_headers[i].next_page_number;
+    if (i + 1 < deleted.size() && next_page_number == deleted[i + 1]) {
+      continue;
+    }
+    const PageId previous_page_number = previousUsedPage(deleted[run_start]);
+    if (previous_page_number == Page::INVALID_NUMBER) {
+      header.first_used_page = next_page_number;
+    } else {
+      PageHeader previous_header = readPageHeader(previous_page_number);
+      previous_header.next_page_number = next_page_number;
+      writePageHeader(previous_page_number, previous_header);
+    }
+    if (next_page_number == Page::INVALID_NUMBER) {
+      header.last_used_page = previous_page_number;
     }
+    run_start = i + 1;
   }
-  // Clear the page and add it to the head of the free list.
-  existing_page.initialize();
-  existing_page.set_next_page_number(header.first_free_page);
-  header.first_free_page = page_number;
-  ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page.header_, previous_page);
+
+  // Clear the pages and add them to the head of the free list.
+  Page free_page;
+  for (std::size_t i = 0; i < deleted.size(); ++i) {
+    free_page.initialize();
+    free_page.set_next_page_number(header.first_free_page);
+    header.first_free_page = deleted[i];
+    ++header.num_free_pages;
+    writePage(deleted[i], free_page.header_, free_page);
   }
-  writePage(page_number, existing_page.header_, existing_page);
   writeHeader(header);
+  for (std::size_t i = 0; i < deleted.size(); ++i) {
+    setFreeSpace(deleted[i], 0);
+  }
 }
 
 FileIterator PageFile::begin() {
@@ -318,33 +804,42 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(reinterpret_cast<const char*>(&new_page.data_[0]),
-                 Page::DATA_SIZE);
-  stream_->flush();
+  if (&header == &new_page.header_) {
+    io_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE,
+               pagePosition(page_number));
+    return;
+  }
+  // assemble the page so that it goes to disk in one write
+  Page page;
+  page.header_ = header;
+  std::memcpy(&page.data_[0], &new_page.data_[0], Page::DATA_SIZE);
+  io_->write(reinterpret_cast<const char*>(&page), Page::SIZE,
+             pagePosition(page_number));
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  io_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader),
+            pagePosition(page_number));
   return header;
 }
 
 
 
 
-BlobFile BlobFile::create(const std::string& filename) {
-  return BlobFile(filename, true /* create_new */);
+BlobFile BlobFile::create(const std::string& filename,
+                          const FileBackend backend) {
+  return BlobFile(filename, true /* create_new */, backend);
 }
 
-BlobFile BlobFile::open(const std::string& filename) {
-  return BlobFile(filename, false /* create_new */);
+BlobFile BlobFile::open(const std::string& filename,
+                        const FileBackend backend) {
+  return BlobFile(filename, false /* create_new */, backend);
 }
 
-BlobFile::BlobFile(const std::string& name, const bool create_new)
-: File(name, create_new) {
+BlobFile::BlobFile(const std::string& name, const bool create_new,
+                   const FileBackend backend)
+: File(name, create_new, backend) {
 }
 
 BlobFile::~BlobFile() {
@@ -361,12 +856,58 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
   openIfNeeded(false /* create_new */);
+  cacheHeader();
   return *this;
 }
 
+void BlobFile::reservePages(const PageId num_pages) {
+  if (num_pages <= header_cache_->reserved_pages) {
+    return;
+  }
+
+  // grow in proportion to the file, so that large files need few extents
+  PageId extent = header_cache_->reserved_pages / 8;
+  if (extent < MIN_EXTENT_PAGES) {
+    extent = MIN_EXTENT_PAGES;
+  } else if (extent > MAX_EXTENT_PAGES) {
+    extent = MAX_EXTENT_PAGES;
+  }
+  const PageId reserved_pages = num_pages - 1 + extent;
+
+  const std::streamoff start = pagePosition(header_cache_->reserved_pages);
+  const std::streamoff end = pagePosition(reserved_pages);
+  if (io_->reserve(start, end - start)) {
+    header_cache_->reserved_pages = reserved_pages;
+  } else {
+    // no preallocation on this filesystem, extend the file one page at a time
+    const Page empty_page;
+    writePage(num_pages - 1, empty_page);
+    header_cache_->reserved_pages = num_pages;
+  }
+}
+
 Page BlobFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
 	Page new_page;
+	allocatePage(new_page_number, new_page);
+	return new_page;
+}
+
+void BlobFile::allocatePage(PageId &new_page_number, Page& new_page) {
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+  FileHeader header = readHeader();
+	new_page.initialize();
+
+	if (header.num_free_pages > 0) {
+		// recycle the head of the free list, whose first bytes hold the next one
+		loadFreePages();
+		new_page_number = header.first_free_page;
+		io_->read(reinterpret_cast<char*>(&header.first_free_page), sizeof(PageId),
+		          pagePosition(new_page_number));
+		--header.num_free_pages;
+		setPageFree(new_page_number, false);
+		writeHeader(header);
+		return;
+	}
 
 	new_page_number = header.num_pages;
 
@@ -376,28 +917,124 @@ Page BlobFile::allocatePage(PageId &new_page_number) {
 
 	++header.num_pages;
 
-	writePage(new_page_number, new_page);
+	// the page itself stays in memory until the caller writes it, and the
+	// header until it is flushed
+	reservePages(header.num_pages);
 	writeHeader(header);
-
-	return new_page;
 }
 
 Page BlobFile::readPage(const PageId page_number) const {
 	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	readPage(page_number, page);
 	return page;
 }
 
+void BlobFile::readPage(const PageId page_number, Page& page) const {
+  FileHeader header = readHeader();
+
+	if (page_number == Page::INVALID_NUMBER || page_number >= header.num_pages ||
+	    isDeleted(page_number, header))
+	{
+		throw InvalidPageException(page_number, filename_);
+	}
+	io_->read(reinterpret_cast<char*>(&page), Page::SIZE, pagePosition(page_number));
+}
+
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	io_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE, pagePosition(new_page_number));
+}
+
+std::size_t BlobFile::readPages(IoEngine& engine, const PageId* page_numbers,
+                                Page* const* pages,
+                                const std::size_t count) const {
+  const FileHeader header = readHeader();
+	std::size_t num_read = 0;
+	while (num_read < count && page_numbers[num_read] != Page::INVALID_NUMBER &&
+	       page_numbers[num_read] < header.num_pages &&
+	       !isDeleted(page_numbers[num_read], header)) {
+		engine.read(*io_, reinterpret_cast<char*>(pages[num_read]), Page::SIZE,
+		            pagePosition(page_numbers[num_read]));
+		++num_read;
+	}
+	engine.wait();
+	return num_read;
+}
+
+void BlobFile::writePages(IoEngine& engine, const PageId* page_numbers,
+                          const Page* const* pages, const std::size_t count) {
+	for (std::size_t i = 0; i < count; ++i) {
+		engine.write(*io_, reinterpret_cast<const char*>(pages[i]), Page::SIZE,
+		             pagePosition(page_numbers[i]));
+	}
+	engine.wait();
 }
 
-//delePage should not be called for a blob_file, not supported
 void BlobFile::deletePage(const PageId page_number) {
-	throw InvalidPageException(page_number, filename_);
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+  FileHeader header = readHeader();
+	loadFreePages();
+	if (page_number == Page::INVALID_NUMBER || page_number >= header.num_pages ||
+	    isPageFree(page_number)) {
+		throw InvalidPageException(page_number, filename_);
+	}
+
+	// the page is cleared, so that nothing of it is left in the file, and put
+	// at the head of the free list
+	std::unique_ptr<Page> free_page(new Page);
+	char* bytes = reinterpret_cast<char*>(free_page.get());
+	std::memset(bytes, 0, Page::SIZE);
+	std::memcpy(bytes, &header.first_free_page, sizeof(PageId));
+	io_->write(bytes, Page::SIZE, pagePosition(page_number));
+	header.first_free_page = page_number;
+	++header.num_free_pages;
+	setPageFree(page_number, true);
+	writeHeader(header);
+}
+
+bool BlobFile::isDeleted(const PageId page_number,
+                         const FileHeader& header) const {
+	// files which never had a page deleted need not look at the list
+	if (header.num_free_pages == 0) {
+		return false;
+	}
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+	loadFreePages();
+	return isPageFree(page_number);
+}
+
+void BlobFile::loadFreePages() const {
+  std::lock_guard<std::recursive_mutex> lock(io_->structureMutex());
+	if (header_cache_->free_pages_loaded) {
+		return;
+	}
+	const FileHeader header = readHeader();
+	header_cache_->free_pages.assign(header.num_pages / 64 + 1, 0);
+	header_cache_->free_pages_loaded = true;
+	PageId page_number = header.first_free_page;
+	for (PageId i = 0; i < header.num_free_pages; ++i) {
+		setPageFree(page_number, true);
+		io_->read(reinterpret_cast<char*>(&page_number), sizeof(PageId),
+		          pagePosition(page_number));
+	}
+}
+
+bool BlobFile::isPageFree(const PageId page_number) const {
+	const std::vector<std::uint64_t>& free_pages = header_cache_->free_pages;
+	return page_number / 64 < free_pages.size() &&
+	    (free_pages[page_number / 64] >> (page_number % 64) & 1) != 0;
+}
+
+void BlobFile::setPageFree(const PageId page_number, const bool free) const {
+	std::vector<std::uint64_t>& free_pages = header_cache_->free_pages;
+	if (page_number / 64 >= free_pages.size()) {
+		free_pages.resize(page_number / 64 + 1, 0);
+	}
+	const std::uint64_t bit = std::uint64_t(1) << (page_number % 64);
+	if (free) {
+		free_pages[page_number / 64] |= bit;
+	} else {
+		free_pages[page_number / 64] &= ~bit;
+	}
 }
 
 }
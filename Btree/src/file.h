@@ -7,11 +7,16 @@
 
 #pragma once
 
+#include <cstdint>
 #include <fstream>
 #include <string>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <vector>
 
+#include "file_io.h"
+#include "io_engine.h"
 #include "page.h"
 
 namespace badgerdb {
@@ -42,6 +47,20 @@ struct FileHeader {
    */
   PageId first_free_page;
 
+  /**
+   * Page number of the last used page in the file, the tail of the used list
+   * of a PageFile, so that new pages are appended without walking the list.
+   */
+  PageId last_used_page;
+
+  /**
+   * Page number of the first page holding the part of the free space map of a
+   * PageFile which does not fit into the header page, see
+   * PageFile::insertRecord().  Further such pages are chained through their
+   * next page pointers.
+   */
+  PageId first_map_page;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,23 +71,101 @@ struct FileHeader {
     return num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        last_used_page == rhs.last_used_page &&
+        first_map_page == rhs.first_map_page;
   }
 };
 
+/**
+ * @brief In-memory copy of the header of an open file, shared by all File
+ *        objects which use the file.
+ */
+struct CachedHeader {
+  /**
+   * Current header of the file.
+   */
+  FileHeader header;
+
+  /**
+   * Number of page slots the file has room for on disk, counted like
+   * num_pages.  Slots past num_pages are preallocated but not in use.
+   */
+  PageId reserved_pages;
+
+  /**
+   * True if the header has changed since it was last written to disk.
+   */
+  bool dirty;
+
+  /**
+   * Bit per page number of a PageFile, set for the pages in the used list.
+   * Built from the list on disk when first needed, see
+   * PageFile::loadUsedPages(), and kept up to date from then on.
+   */
+  std::vector<std::uint64_t> used_pages;
+
+  /**
+   * True once used_pages has been built.
+   */
+  bool used_pages_loaded;
+
+  /**
+   * Free space category of every page of a PageFile, by page number.  Loaded
+   * from disk when first needed, see PageFile::loadFreeSpaceMap().
+   */
+  std::vector<std::uint8_t> free_space;
+
+  /**
+   * True once free_space has been loaded.
+   */
+  bool free_space_loaded;
+
+  /**
+   * True if free_space has changed since it was last written to disk.
+   */
+  bool free_space_dirty;
+
+  /**
+   * Pages holding the part of the free space map past the header page.
+   */
+  std::vector<PageId> map_pages;
+
+  /**
+   * Lowest page number which may have each category of free space or more,
+   * so that searches do not look at full pages again.
+   */
+  std::vector<PageId> free_space_hints;
+
+  /**
+   * Bit per page number of a BlobFile, set for the pages in the free list.
+   * Built from the list on disk when first needed, see
+   * BlobFile::loadFreePages().
+   */
+  std::vector<std::uint64_t> free_pages;
+
+  /**
+   * True once free_pages has been built.
+   */
+  bool free_pages_loaded;
+};
+
 /**
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
  *
- * The File class wraps a stream to an underlying file on disk.  Files contain
- * fixed-sized pages, and they never deallocate space (though they do reuse
- * deleted pages if possible).  If multiple File objects refer to the same
- * underlying file, they will share the stream in memory.
+ * The File class wraps a FileIO object doing I/O on an underlying file on
+ * disk.  Files contain fixed-sized pages, and they never deallocate space
+ * (though they do reuse deleted pages if possible).  If multiple File objects
+ * refer to the same underlying file, they will share the FileIO object in
+ * memory.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
- * the already created stream for the file without actually opening the UNIX file again. 
+ * detects this (by looking up its name in the open_ids_ map) and just returns a file object with
+ * the already open FileIO object for the file without actually opening the UNIX file again. 
  *
- * @warning This class is not threadsafe.
+ * Pages may be read and written from several threads at once; allocating and
+ * deleting pages and updating the header are serialized per file.  A single
+ * File object must still not be assigned to while other threads use it.
  */
 
 
@@ -80,12 +177,14 @@ class File {
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param backend     How to do I/O on the file, unless it is open already.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new,
+       const FileBackend backend = FileBackend::POSITIONAL);
 
   /**
    * Deletes an existing file.
@@ -103,6 +202,23 @@ class File {
    */
   static bool isOpen(const std::string& filename);
 
+  /**
+   * Makes the bytes written to the file so far durable, after writing its
+   * header if the file is open and the header has changed.  The file need
+   * not be open.
+   *
+   * @param filename  Name of the file.
+   * @return  False if the file could not be synced; true if it does not
+   *          exist.
+   */
+  static bool syncFile(const std::string& filename);
+
+  /**
+   * Returns the names of the open files whose cached header has changed
+   * since it was last written.
+   */
+  static std::vector<std::string> dirtyHeaderFiles();
+
 
   /**
    * Returns true if the file exists and is open.
@@ -124,6 +240,15 @@ class File {
    */
   virtual Page allocatePage(PageId &new_page_number) = 0;
 
+  /**
+   * Allocates a new page in the file, building it in memory provided by the
+   * caller instead of returning a copy.
+   *
+   * @param new_page_number   Number of the new page is returned here.
+   * @param new_page          Overwritten with the new page.
+   */
+  virtual void allocatePage(PageId &new_page_number, Page& new_page) = 0;
+
   /**
    * Reads an existing page from the file.
    *
@@ -134,6 +259,18 @@ class File {
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
+  /**
+   * Reads an existing page from the file straight into memory provided by
+   * the caller, such as a buffer pool frame, instead of returning a copy.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Overwritten with the page.  Its contents are
+   *                      undefined if an exception is thrown.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  virtual void readPage(const PageId page_number, Page& page) const = 0;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -143,6 +280,36 @@ class File {
    */
   virtual void writePage(const PageId page_number, const Page& new_page) = 0;
 
+  /**
+   * Reads a batch of existing pages through an I/O engine, which may have
+   * all of them in flight at once.
+   *
+   * @param engine        Engine doing the reads.
+   * @param page_numbers  Numbers of the pages to read.
+   * @param pages         Overwritten with the pages, in the same order.
+   * @param count         Number of pages to read.
+   * @return  Number of pages read, counted from the first one.  Reading stops
+   *          at the first page which doesn't exist in the file or is not
+   *          currently used; the contents of that page and the following
+   *          ones are undefined.
+   */
+  virtual std::size_t readPages(IoEngine& engine, const PageId* page_numbers,
+                                Page* const* pages,
+                                const std::size_t count) const = 0;
+
+  /**
+   * Writes a batch of pages through an I/O engine, which may have all of
+   * them in flight at once.  Otherwise the same as writePage().
+   *
+   * @param engine        Engine doing the writes.
+   * @param page_numbers  Numbers of the pages whose contents to replace.
+   * @param pages         Pages to write, in the same order.
+   * @param count         Number of pages to write.
+   */
+  virtual void writePages(IoEngine& engine, const PageId* page_numbers,
+                          const Page* const* pages,
+                          const std::size_t count) = 0;
+
   /**
    * Deletes a page from the file.
    *
@@ -157,6 +324,15 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns the id of the file this object represents.  All File objects
+   * using the same open file share the id; once the file is closed, the id
+   * may be given to another file.
+   *
+   * @return Id of file.
+   */
+  FileId id() const { return id_; }
+
  	/**
    * Returns pageid of first page in the file.
    *
@@ -164,64 +340,181 @@ class File {
    */
 	PageId getFirstPageNo();
 
+  /**
+   * Writes the header of the file to disk if it has changed since it was last
+   * written, along with the free space map of a PageFile.  Changes to the
+   * header are only made in memory until then; the
+   * header is also written by sync(), by BufMgr::checkpoint() and
+   * BufMgr::flushFile(), and when the last File object using the file closes
+   * it.
+   */
+  void flushHeader() const;
+
+  /**
+   * Makes the file durable: writes the header if it has changed, then waits until everything written to the file is on the
+   * device.  Writes are not durable before this, or before the file is closed
+   * and the system has written it back.
+   *
+   * @return  False if the file could not be synced.
+   */
+  bool sync() const;
+
+  /**
+   * Returns the backend doing I/O on the file.  All File objects using the
+   * file share the backend of the one which opened it first.
+   */
+  FileBackend backend() const { return io_->backend(); }
+
+  /**
+   * Tells the kernel in which order the pages of the file are going to be
+   * read, such as sequentially by a scan or randomly by an index lookup.  The
+   * hint applies to all File objects using the file.
+   *
+   * @param access  Expected access pattern.
+   */
+  void adviseAccess(const FileAccess access) { io_->advise(access); }
+
+  /**
+   * Returns the page as it is mapped in memory, without copying it, if the
+   * file was opened with the MAPPED backend.  The page must only be read.  It
+   * stays at this address until the file is closed, and changes when the page
+   * is written to the file.
+   *
+   * @param page_number   Number of page.
+   * @return  The mapped page, or NULL if the file is not mapped or the page
+   *          does not exist in the file.
+   */
+  const Page* mappedPage(const PageId page_number) const;
+
  protected:
   /**
    * Returns the position of the page with the given number in the file (as an
-   * offset from the beginning of the file).
+   * offset from the beginning of the file).  The file header takes up the
+   * whole first page, so that every page starts at a multiple of Page::SIZE
+   * as needed for the DIRECT backend.
    *
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
   static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+    return (std::streamoff) page_number * Page::SIZE;
   }
 
   /**
-   * Opens the underlying file named in filename_.
+   * Opens the underlying file named in filename_ and sets id_.
    * This method only opens the file if no other File objects exist that access
-   * the same filesystem file; otherwise, it reuses the existing stream.
+   * the same filesystem file; otherwise, it reuses the existing FileIO object
+   * and file id.
    *
    * @param create_new  Whether to create a new file.
+   * @param backend     How to do I/O on the file if it is opened.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  void openIfNeeded(const bool create_new);
+  void openIfNeeded(const bool create_new,
+                    const FileBackend backend = FileBackend::POSITIONAL);
 
   /**
-   * Closes the underlying file stream in <stream_>.
+   * Closes the underlying file in <io_>.
    * This method only closes the file if no other File objects exist that access
    * the same file.
    */
   void close();
 
   /**
-   * Reads the header for this file from disk.
+   * Keeps the header of this file in memory from now on, shared with the
+   * other File objects using the file.  readHeader() and writeHeader() then
+   * no longer go to disk; see flushHeader().  Every File object does this
+   * once the file is open.
+   */
+  void cacheHeader();
+
+  /**
+   * Reads the header for this file from disk, or from memory if it is cached.
    *
    * @return  The file header.
    */
   FileHeader readHeader() const;
 
   /**
-   * Writes the given header to the disk as the header for this file.
+   * Writes the given header to the disk as the header for this file.  If the
+   * header is cached it is only updated in memory.
    *
    * @param header  File header to write.
    */
   void writeHeader(const FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
-  typedef std::map<std::string, int> CountMap;
+  /**
+   * Number of entries of the free space map held by the header page after
+   * the file header, and by every other page of the map.  An entry takes 4
+   * bits.
+   */
+  static const PageId HEADER_MAP_ENTRIES = (Page::SIZE - sizeof(FileHeader)) * 2;
+  static const PageId MAP_PAGE_ENTRIES = Page::DATA_SIZE * 2;
+
+  /**
+   * Writes a cached header to the file if it has changed, see flushHeader().
+   * The caller holds the structure mutex of the file.
+   *
+   * @param io     File to write to.
+   * @param cache  Header of the file.
+   */
+  static void writeCachedHeader(FileIO& io, CachedHeader& cache);
+
+  /**
+   * Writes the free space map of a PageFile together with the header.  Pages
+   * for the part of the map past the header page are added at the end of
+   * the file as the map grows.
+   *
+   * @param io     File to write to.
+   * @param cache  Header and free space map of the file.
+   */
+  static void writeFreeSpaceMap(FileIO& io, CachedHeader& cache);
+
+  /**
+   * @brief Entry of the registry of opened files.
+   */
+  struct OpenFile {
+    /**
+     * I/O object of the file, empty if the entry is not in use.
+     */
+    std::shared_ptr<FileIO> io;
+
+    /**
+     * Number of File objects using the file.
+     */
+    int count;
+
+    /**
+     * Cached header of the file, empty until the first File object caches
+     * it.
+     */
+    std::shared_ptr<CachedHeader> header;
+  };
+
+  typedef std::map<std::string, FileId> IdMap;
+
+  /**
+   * Opened files, indexed by file id.
+   */
+  static std::vector<OpenFile> open_files_;
+
+  /**
+   * Ids of entries in open_files_ which are not in use.
+   */
+  static std::vector<FileId> free_ids_;
 
   /**
-   * Streams for opened files.
+   * Ids of opened files by name, only looked up when a file is opened.
    */
-  static StreamMap open_streams_;
+  static IdMap open_ids_;
 
   /**
-   * Counts for opened files.
+   * Lock for the registry of opened files above.
    */
-  static CountMap open_counts_;
+  static std::mutex open_mutex_;
 
   /**
    * Name of the file this object represents.
@@ -229,9 +522,19 @@ class File {
   std::string filename_;
 
   /**
-   * Stream for underlying filesystem object.
+   * Id of the file this object represents, valid while io_ is set.
+   */
+  FileId id_;
+
+  /**
+   * I/O object for underlying filesystem object.
    */
-  std::shared_ptr<std::fstream> stream_;
+  std::shared_ptr<FileIO> io_;
+
+  /**
+   * Cached header of the file, empty if the header is read from disk.
+   */
+  std::shared_ptr<CachedHeader> header_cache_;
 
   friend class FileIterator;
 };
@@ -243,33 +546,39 @@ class PageFile : public File {
    * Creates a new file.
    *
    * @param filename  Name of the file.
+   * @param backend   How to do I/O on the file.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static PageFile create(const std::string& filename);
+  static PageFile create(const std::string& filename,
+                         const FileBackend backend = FileBackend::POSITIONAL);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
-	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * It first checks if the file is already open. If so, then the new File object created uses the same FileIO object to read from or write to
+	 * that already open file. The reference count in its entry of the open_files_ registry is incremented whenever an already open file is
+	 * opened again. Otherwise the UNIX file is actually opened, and the FileIO object associated with this File object is registered under a
+	 * new file id.
    *
    * @param filename  Name of the file.
+   * @param backend   How to do I/O on the file, unless it is open already.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
-  static PageFile open(const std::string& filename);
+  static PageFile open(const std::string& filename,
+                       const FileBackend backend = FileBackend::POSITIONAL);
 
   /**
    * Constructs a file object representing a file on the filesystem.
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param backend     How to do I/O on the file, unless it is open already.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  PageFile(const std::string& name, const bool create_new);
+  PageFile(const std::string& name, const bool create_new,
+           const FileBackend backend = FileBackend::POSITIONAL);
 
   /**
    * Copy constructor.
@@ -280,7 +589,9 @@ class PageFile : public File {
   PageFile(const PageFile& other);
 
   /**
-   * Assignment operator.
+   * Assignment operator.  Assigning an object for the same file keeps the
+   * id, so a buffer pool still finds the pages it holds for this object; any
+   * other file has to be flushed from buffer pools first.
    *
    * @param rhs File object to assign.
    * @return    Newly assigned file object.
@@ -300,6 +611,15 @@ class PageFile : public File {
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file, building it in memory provided by the
+   * caller instead of returning a copy.
+   *
+   * @param new_page_number   Number of the new page is returned here.
+   * @param new_page          Overwritten with the new page.
+   */
+  void allocatePage(PageId &new_page_number, Page& new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -310,6 +630,18 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file straight into memory provided by
+   * the caller, such as a buffer pool frame, instead of returning a copy.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Overwritten with the page.  Its contents are
+   *                      undefined if an exception is thrown.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page& page) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -319,13 +651,89 @@ class PageFile : public File {
    */
   void writePage(const PageId page_number, const Page& new_page);
 
+  /**
+   * Reads a batch of pages, see File::readPages().
+   */
+  std::size_t readPages(IoEngine& engine, const PageId* page_numbers,
+                        Page* const* pages, const std::size_t count) const;
+
+  /**
+   * Writes a batch of pages, see File::writePages().
+   *
+   * @throws  InvalidPageException  If one of the pages has been deleted since
+   *                                it was read.  No page is written then.
+   */
+  void writePages(IoEngine& engine, const PageId* page_numbers,
+                  const Page* const* pages, const std::size_t count);
+
   /**
    * Deletes a page from the file.
    *
    * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page is not in use.
    */
   void deletePage(const PageId page_number);
 
+  /**
+   * Deletes a batch of pages from the file.  The used list is relinked once
+   * around every run of deleted pages, each page being unlinked without
+   * walking the list.
+   *
+   * @param page_numbers  Numbers of the pages to delete, in any order.
+   * @param count         Number of pages to delete.
+   * @throws  InvalidPageException  If one of the pages is not in use.  No
+   *                                page is deleted then.
+   */
+  void deletePages(const PageId* page_numbers, const std::size_t count);
+
+  /**
+   * Number of categories of free space tracked per page by the free space
+   * map.  A page in category c has at least c / (FREE_SPACE_CATEGORIES - 1)
+   * of its data area free.
+   */
+  static const std::uint8_t FREE_SPACE_CATEGORIES = 16;
+
+  /**
+   * Inserts a record into a page of the file with room for it, allocating a
+   * page only if there is none.  The page is found through the free space
+   * map, which is kept up to date by every page written to the file and
+   * persisted with the header, so that space freed by deleting records is
+   * used again.
+   *
+   * This is the unbuffered path: the page is read and written directly on
+   * the file, so frames holding pages of the file in a buffer pool would go
+   * stale.  Files used through a buffer pool, such as the relations the
+   * B-tree indexes are built from, insert with BufMgr::insertRecord()
+   * instead.
+   *
+   * @param record_data   Bytes that compose the record.
+   * @return  ID of the inserted record.
+   * @throws  InsufficientSpaceException  If the record does not fit into an
+   *                                      empty page.
+   */
+  RecordId insertRecord(const std::string& record_data);
+
+  /**
+   * Returns the lowest numbered page from the given one on which the free
+   * space map expects room for a record of the given length, or
+   * Page::INVALID_NUMBER if there is none.  The page may turn out to be
+   * fuller than the map says; updateFreeSpace() then corrects the map.
+   *
+   * @param record_length   Length of the record in bytes.
+   * @param from            Page number to start the search at.
+   * @return  Number of a page which may have room for the record.
+   */
+  PageId findPageWithSpace(const std::size_t record_length, const PageId from);
+
+  /**
+   * Records the free space of a page in the free space map, for pages
+   * changed without being written to the file yet.
+   *
+   * @param page_number   Number of the page.
+   * @param page          Current contents of the page.
+   */
+  void updateFreeSpace(const PageId page_number, const Page& page);
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -347,8 +755,8 @@ class PageFile : public File {
    * Reads a page from the file.  If <allow_free> is not set, an exception
    * will be thrown if the page read from disk is not currently in use.
    *
-   * No bounds checking is performed; the underlying file stream will throw
-   * an exception if the page is past the end of the file.
+   * No bounds checking is performed; a page past the end of the file reads
+   * as zeroes, that is as a free page.
    *
    * @param page_number   Number of page to read.
    * @param allow_free    Whether to allow reading a free (unused) page.
@@ -358,6 +766,19 @@ class PageFile : public File {
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
+  /**
+   * Reads a page from the file into the given page.  Otherwise the same as
+   * readPage(page_number, allow_free).
+   *
+   * @param page_number   Number of page to read.
+   * @param allow_free    Whether to allow reading a free (unused) page.
+   * @param page          Overwritten with the page.
+   * @throws  InvalidPageException  If the page is free (unused) and
+   *                                allow_free is false.
+   */
+  void readPage(const PageId page_number, const bool allow_free,
+                Page& page) const;
+
   /**
    * Writes a page into the file at the given page number with the given header.
    * This does not ensure that the number in the header equals the position on
@@ -379,6 +800,56 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Writes only the header of the given page to disk.  No bounds checking is
+   * performed.
+   *
+   * @param page_number   Number of page whose header is to be written.
+   * @param header        Header of page.
+   */
+  void writePageHeader(const PageId page_number, const PageHeader& header);
+
+  /**
+   * Builds the bitmap of used pages in the cached header by walking the used
+   * list once, unless it has been built already.
+   */
+  void loadUsedPages();
+
+  /**
+   * Marks a page as used or not in the bitmap of used pages, if it has been
+   * built.
+   */
+  void setPageUsed(const PageId page_number, const bool used);
+
+  /**
+   * Returns the highest numbered used page below the given page, or
+   * Page::INVALID_NUMBER if there is none.  The bitmap of used pages must have
+   * been built.
+   */
+  PageId previousUsedPage(const PageId page_number) const;
+
+  /**
+   * Loads the free space map from the header page and the pages chained from
+   * first_map_page, unless it has been loaded already.
+   */
+  void loadFreeSpaceMap();
+
+  /**
+   * Sets the free space category of a page in the free space map.
+   */
+  void setFreeSpace(const PageId page_number, const std::uint8_t category);
+
+  /**
+   * Returns the free space category of the given page, 0 if it is not used.
+   */
+  static std::uint8_t freeSpaceCategory(const Page& page);
+
+  /**
+   * Returns the lowest numbered page from the given one on whose free space
+   * category is at least the given one, or Page::INVALID_NUMBER.
+   */
+  PageId findFreeSpace(const std::uint8_t category, const PageId from);
+
   friend class FileIterator;
 };
 
@@ -389,21 +860,25 @@ class BlobFile : public File {
    * Creates a new BlobFile.
    *
    * @param filename  Name of the file.
+   * @param backend   How to do I/O on the file.
    * @throws  FileExistsException     If the requested file already exists.
    */
-  static BlobFile create(const std::string& filename);
+  static BlobFile create(const std::string& filename,
+                         const FileBackend backend = FileBackend::POSITIONAL);
 
   /**
    * Opens the file named fileName and returns the corresponding File object.
-	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
-	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * It first checks if the file is already open. If so, then the new File object created uses the same FileIO object to read from or write to
+	 * that already open file. The reference count in its entry of the open_files_ registry is incremented whenever an already open file is
+	 * opened again. Otherwise the UNIX file is actually opened, and the FileIO object associated with this File object is registered under a
+	 * new file id.
    *
    * @param filename  Name of the file.
+   * @param backend   How to do I/O on the file, unless it is open already.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
-  static BlobFile open(const std::string& filename);
+  static BlobFile open(const std::string& filename,
+                       const FileBackend backend = FileBackend::POSITIONAL);
 
   /**
    * Constructs a file object representing a file on the filesystem.
@@ -412,12 +887,14 @@ class BlobFile : public File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param backend     How to do I/O on the file, unless it is open already.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  BlobFile(const std::string& name, const bool create_new);
+  BlobFile(const std::string& name, const bool create_new,
+           const FileBackend backend = FileBackend::POSITIONAL);
 
   /**
    * Copy constructor.
@@ -428,7 +905,9 @@ class BlobFile : public File {
   BlobFile(const BlobFile& other);
 
   /**
-   * Assignment operator.
+   * Assignment operator.  Assigning an object for the same file keeps the
+   * id, so a buffer pool still finds the pages it holds for this object; any
+   * other file has to be flushed from buffer pools first.
    *
    * @param rhs File object to assign.
    * @return    Newly assigned file object.
@@ -448,6 +927,18 @@ class BlobFile : public File {
    */
   Page allocatePage(PageId &new_page_number);
 
+  /**
+   * Allocates a new page in the file, building it in memory provided by the
+   * caller instead of returning a copy.  A page deleted earlier is recycled
+   * if there is one; otherwise the file grows by extents.  The new page is
+   * not written; its contents on disk are undefined until the caller writes
+   * it.
+   *
+   * @param new_page_number   Number of the new page is returned here.
+   * @param new_page          Overwritten with the new page.
+   */
+  void allocatePage(PageId &new_page_number, Page& new_page);
+
   /**
    * Reads an existing page from the file.
    *
@@ -458,6 +949,18 @@ class BlobFile : public File {
    */
   Page readPage(const PageId page_number) const;
 
+  /**
+   * Reads an existing page from the file straight into memory provided by
+   * the caller, such as a buffer pool frame, instead of returning a copy.
+   *
+   * @param page_number   Number of page to read.
+   * @param page          Overwritten with the page.  Its contents are
+   *                      undefined if an exception is thrown.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
+   */
+  void readPage(const PageId page_number, Page& page) const;
+
   /**
    * Writes a page into the file at the given page number.
    * No bounds checking is performed.
@@ -468,11 +971,69 @@ class BlobFile : public File {
   void writePage(const PageId page_number, const Page& new_page);
 
   /**
-   * Deletes a page from the file.
+   * Reads a batch of pages, see File::readPages().
+   */
+  std::size_t readPages(IoEngine& engine, const PageId* page_numbers,
+                        Page* const* pages, const std::size_t count) const;
+
+  /**
+   * Writes a batch of pages, see File::writePages().
+   */
+  void writePages(IoEngine& engine, const PageId* page_numbers,
+                  const Page* const* pages, const std::size_t count);
+
+  /**
+   * Deletes a page from the file, putting it on the free list of the file
+   * for allocatePage() to recycle.  The free list is chained through the
+   * first bytes of the free pages, so the contents of a deleted page are
+   * lost, and reading it throws InvalidPageException until it is allocated
+   * again.
    *
    * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page does not exist in the file or
+   *                                has been deleted already.
    */
   void deletePage(const PageId page_number);
+
+ private:
+  /**
+   * Returns true if the page is in the free list, given the current header
+   * of the file.
+   */
+  bool isDeleted(const PageId page_number, const FileHeader& header) const;
+
+  /**
+   * Builds the bitmap of free pages in the cached header by walking the free
+   * list once, unless it has been built already.  Only the cached header is
+   * changed.
+   */
+  void loadFreePages() const;
+
+  /**
+   * Returns true if the page is in the free list.  The bitmap of free pages
+   * must have been built.
+   */
+  bool isPageFree(const PageId page_number) const;
+
+  /**
+   * Marks a page as free or not in the bitmap of free pages.  Only the
+   * cached header is changed.
+   */
+  void setPageFree(const PageId page_number, const bool free) const;
+
+  /**
+   * Smallest and largest number of pages by which the file is grown at once.
+   */
+  static const PageId MIN_EXTENT_PAGES = 16;
+  static const PageId MAX_EXTENT_PAGES = 1024;
+
+  /**
+   * Makes sure there is room on disk for the given number of pages, growing
+   * the file by a whole extent if there is not.
+   *
+   * @param num_pages   Number of page slots needed, counted like num_pages.
+   */
+  void reservePages(const PageId num_pages);
 };
 
 }
@@ -0,0 +1,447 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "file_io.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "exceptions/file_io_exception.h"
+
+namespace badgerdb {
+
+template <class IO>
+static FileIO* openIO(const std::string& name, const bool create_new) {
+  IO* io = new IO(name, create_new);
+  if (!io->isOpen()) {
+    delete io;
+    return NULL;
+  }
+  return io;
+}
+
+FileIO* FileIO::open(const std::string& name, const bool create_new,
+                     const FileBackend backend) {
+  switch (backend) {
+    case FileBackend::POSITIONAL:
+      return openIO<PositionalFileIO>(name, create_new);
+    case FileBackend::MAPPED:
+      return openIO<MappedFileIO>(name, create_new);
+    case FileBackend::DIRECT:
+      return openIO<DirectFileIO>(name, create_new);
+    default:
+      return openIO<StreamFileIO>(name, create_new);
+  }
+}
+
+// Smallest mapping made, so that small files which grow do not need to be
+// remapped every few pages.
+static const std::size_t MIN_MAPPING = 1 << 20;
+
+static int openDescriptor(const std::string& name, const bool create_new,
+                          const int extra_flags = 0) {
+  int flags = O_RDWR | extra_flags;
+  if (create_new) {
+    flags |= O_CREAT | O_TRUNC;
+  }
+  return ::open(name.c_str(), flags, 0644);
+}
+
+// Reads with pread() until done or at the end of the file, zeroing the rest.
+static void readFully(const int fd, char* data, const std::size_t length,
+                      const std::streamoff offset) {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t n = ::pread(fd, data + done, length - done, offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      throw FileIOException("read", offset + done, errno);
+    }
+    if (n == 0) {
+      // end of the file
+      break;
+    }
+    done += n;
+  }
+  std::memset(data + done, 0, length - done);
+}
+
+static void writeFully(const int fd, const char* data,
+                       const std::size_t length, const std::streamoff offset) {
+  std::size_t done = 0;
+  while (done < length) {
+    const ssize_t n = ::pwrite(fd, data + done, length - done, offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      throw FileIOException("write", offset + done, errno);
+    }
+    if (n == 0) {
+      // nothing written and no error, which only a full device does
+      throw FileIOException("write", offset + done, ENOSPC);
+    }
+    done += n;
+  }
+}
+
+static std::streamoff descriptorSize(const int fd) {
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    return 0;
+  }
+  return st.st_size;
+}
+
+static int fadviseFlag(const FileAccess access) {
+  switch (access) {
+    case FileAccess::SEQUENTIAL:
+      return POSIX_FADV_SEQUENTIAL;
+    case FileAccess::RANDOM:
+      return POSIX_FADV_RANDOM;
+    default:
+      return POSIX_FADV_NORMAL;
+  }
+}
+
+static int madviseFlag(const FileAccess access) {
+  switch (access) {
+    case FileAccess::SEQUENTIAL:
+      return MADV_SEQUENTIAL;
+    case FileAccess::RANDOM:
+      return MADV_RANDOM;
+    default:
+      return MADV_NORMAL;
+  }
+}
+
+StreamFileIO::StreamFileIO(const std::string& name, const bool create_new)
+    : name_(name) {
+  std::ios_base::openmode mode =
+      std::fstream::in | std::fstream::out | std::fstream::binary;
+  if (create_new) {
+    // New files have to be truncated on open.
+    mode = mode | std::fstream::trunc;
+  }
+  stream_.open(name.c_str(), mode);
+}
+
+void StreamFileIO::read(char* data, const std::size_t length,
+                        const std::streamoff offset) {
+  std::lock_guard<std::mutex> lock(stream_mutex_);
+  stream_.seekg(offset, std::ios::beg);
+  stream_.read(data, length);
+  if (!stream_) {
+    // a read past the end must not leave the shared stream in a failed state
+    const bool failed = stream_.bad();
+    stream_.clear();
+    if (failed) {
+      throw FileIOException("read", offset, EIO);
+    }
+    std::memset(data + stream_.gcount(), 0, length - stream_.gcount());
+  }
+}
+
+void StreamFileIO::write(const char* data, const std::size_t length,
+                         const std::streamoff offset) {
+  std::lock_guard<std::mutex> lock(stream_mutex_);
+  stream_.seekp(offset, std::ios::beg);
+  stream_.write(data, length);
+  if (!stream_) {
+    stream_.clear();
+    throw FileIOException("write", offset, EIO);
+  }
+}
+
+std::streamoff StreamFileIO::size() {
+  std::lock_guard<std::mutex> lock(stream_mutex_);
+  stream_.seekg(0, std::ios::end);
+  return stream_.tellg();
+}
+
+bool StreamFileIO::sync() {
+  {
+    std::lock_guard<std::mutex> lock(stream_mutex_);
+    stream_.flush();
+    if (!stream_) {
+      stream_.clear();
+      return false;
+    }
+  }
+  // as for reserve(), the sync goes through another descriptor of the file
+  bool synced = false;
+  const int fd = ::open(name_.c_str(), O_WRONLY);
+  if (fd >= 0) {
+    synced = fdatasync(fd) == 0;
+    ::close(fd);
+  }
+  return synced;
+}
+
+bool StreamFileIO::reserve(const std::streamoff offset,
+                           const std::streamoff length) {
+  // the stream does not expose its descriptor, so preallocate through another
+  bool reserved = false;
+  const int fd = ::open(name_.c_str(), O_WRONLY);
+  if (fd >= 0) {
+    reserved = posix_fallocate(fd, offset, length) == 0;
+    ::close(fd);
+  }
+  return reserved;
+}
+
+void StreamFileIO::advise(const FileAccess access) {
+  // the stream reads through its own buffer, hints would not reach it
+}
+
+PositionalFileIO::PositionalFileIO(const std::string& name,
+                                   const bool create_new)
+    : fd_(openDescriptor(name, create_new)) {
+}
+
+PositionalFileIO::~PositionalFileIO() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+void PositionalFileIO::read(char* data, const std::size_t length,
+                            const std::streamoff offset) {
+  readFully(fd_, data, length, offset);
+}
+
+void PositionalFileIO::write(const char* data, const std::size_t length,
+                             const std::streamoff offset) {
+  writeFully(fd_, data, length, offset);
+}
+
+std::streamoff PositionalFileIO::size() {
+  return descriptorSize(fd_);
+}
+
+bool PositionalFileIO::sync() {
+  return fdatasync(fd_) == 0;
+}
+
+bool PositionalFileIO::reserve(const std::streamoff offset,
+                               const std::streamoff length) {
+  return posix_fallocate(fd_, offset, length) == 0;
+}
+
+void PositionalFileIO::advise(const FileAccess access) {
+  posix_fadvise(fd_, 0, 0, fadviseFlag(access));
+}
+
+DirectFileIO::DirectFileIO(const std::string& name, const bool create_new)
+    : fd_(openDescriptor(name, create_new, O_DIRECT)), direct_(true) {
+  if (fd_ < 0 && errno == EINVAL) {
+    // the filesystem does not support direct I/O, tmpfs for instance
+    fd_ = openDescriptor(name, create_new);
+    direct_ = false;
+  }
+}
+
+DirectFileIO::~DirectFileIO() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+static bool isAligned(const std::size_t value) {
+  return value % DirectFileIO::ALIGNMENT == 0;
+}
+
+bool DirectFileIO::acceptsDirectly(const char* data, const std::size_t length,
+                                   const std::streamoff offset) const {
+  return fd_ >= 0 && isAligned(reinterpret_cast<std::uintptr_t>(data)) &&
+      isAligned(length) && isAligned(offset);
+}
+
+// Aligned memory covering the blocks of a file range, freed when it goes out
+// of scope.
+class BlockBuffer {
+ public:
+  BlockBuffer(const std::size_t length, const std::streamoff offset)
+      : start_(offset - offset % DirectFileIO::ALIGNMENT), data_(NULL) {
+    const std::streamoff end = offset + length;
+    length_ = (end - start_ + DirectFileIO::ALIGNMENT - 1) /
+        DirectFileIO::ALIGNMENT * DirectFileIO::ALIGNMENT;
+    if (posix_memalign(reinterpret_cast<void**>(&data_),
+                       DirectFileIO::ALIGNMENT, length_) != 0) {
+      throw std::bad_alloc();
+    }
+  }
+  ~BlockBuffer() { std::free(data_); }
+
+  std::streamoff start() const { return start_; }
+  std::size_t length() const { return length_; }
+  char* data() { return data_; }
+
+ private:
+  std::streamoff start_;
+  std::size_t length_;
+  char* data_;
+};
+
+void DirectFileIO::read(char* data, const std::size_t length,
+                        const std::streamoff offset) {
+  if (acceptsDirectly(data, length, offset)) {
+    readFully(fd_, data, length, offset);
+    return;
+  }
+  BlockBuffer blocks(length, offset);
+  readFully(fd_, blocks.data(), blocks.length(), blocks.start());
+  std::memcpy(data, blocks.data() + (offset - blocks.start()), length);
+}
+
+void DirectFileIO::write(const char* data, const std::size_t length,
+                         const std::streamoff offset) {
+  if (acceptsDirectly(data, length, offset)) {
+    writeFully(fd_, data, length, offset);
+    return;
+  }
+  BlockBuffer blocks(length, offset);
+  std::lock_guard<std::mutex> lock(unaligned_mutex_);
+  readFully(fd_, blocks.data(), blocks.length(), blocks.start());
+  std::memcpy(blocks.data() + (offset - blocks.start()), data, length);
+  writeFully(fd_, blocks.data(), blocks.length(), blocks.start());
+}
+
+std::streamoff DirectFileIO::size() {
+  return descriptorSize(fd_);
+}
+
+bool DirectFileIO::sync() {
+  return fdatasync(fd_) == 0;
+}
+
+bool DirectFileIO::reserve(const std::streamoff offset,
+                           const std::streamoff length) {
+  return posix_fallocate(fd_, offset, length) == 0;
+}
+
+void DirectFileIO::advise(const FileAccess access) {
+  // nothing is read ahead into the page cache, the buffer pool reads ahead
+}
+
+MappedFileIO::MappedFileIO(const std::string& name, const bool create_new)
+    : fd_(openDescriptor(name, create_new)), mapping_(NULL),
+      access_(FileAccess::NORMAL) {
+}
+
+MappedFileIO::~MappedFileIO() {
+  old_mappings_.push_back(mapping_.load());
+  for (std::size_t i = 0; i < old_mappings_.size(); i++) {
+    if (old_mappings_[i] != NULL) {
+      munmap(old_mappings_[i]->base, old_mappings_[i]->capacity);
+      delete old_mappings_[i];
+    }
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+MappedFileIO::Mapping* MappedFileIO::mapping(const std::size_t needed) {
+  Mapping* current = mapping_.load(std::memory_order_acquire);
+  if (current != NULL && needed <= current->size.load(std::memory_order_acquire)) {
+    return current;
+  }
+
+  std::lock_guard<std::mutex> lock(map_mutex_);
+  current = mapping_.load(std::memory_order_relaxed);
+  const std::size_t file_size = descriptorSize(fd_);
+  if (current != NULL && file_size <= current->capacity) {
+    // the file grew into the mapping
+    if (file_size > current->size.load(std::memory_order_relaxed)) {
+      current->size.store(file_size, std::memory_order_release);
+    }
+    return current;
+  }
+  if (file_size == 0) {
+    return current;
+  }
+
+  std::size_t capacity = current == NULL ? MIN_MAPPING : 2 * current->capacity;
+  if (capacity < file_size) {
+    capacity = file_size;
+  }
+  void* base = mmap(NULL, capacity, PROT_READ, MAP_SHARED, fd_, 0);
+  if (base == MAP_FAILED) {
+    return current;
+  }
+  madvise(base, capacity, madviseFlag(access_));
+
+  Mapping* grown = new Mapping;
+  grown->base = static_cast<char*>(base);
+  grown->capacity = capacity;
+  grown->size.store(file_size, std::memory_order_relaxed);
+  if (current != NULL) {
+    old_mappings_.push_back(current);
+  }
+  mapping_.store(grown, std::memory_order_release);
+  return grown;
+}
+
+void MappedFileIO::read(char* data, const std::size_t length,
+                        const std::streamoff offset) {
+  const char* address = mappedAddress(offset, length);
+  if (address != NULL) {
+    std::memcpy(data, address, length);
+  } else {
+    // the range lies past the end of the file, or the file cannot be mapped
+    readFully(fd_, data, length, offset);
+  }
+}
+
+void MappedFileIO::write(const char* data, const std::size_t length,
+                         const std::streamoff offset) {
+  writeFully(fd_, data, length, offset);
+}
+
+std::streamoff MappedFileIO::size() {
+  return descriptorSize(fd_);
+}
+
+bool MappedFileIO::sync() {
+  return fdatasync(fd_) == 0;
+}
+
+bool MappedFileIO::reserve(const std::streamoff offset,
+                           const std::streamoff length) {
+  return posix_fallocate(fd_, offset, length) == 0;
+}
+
+void MappedFileIO::advise(const FileAccess access) {
+  std::lock_guard<std::mutex> lock(map_mutex_);
+  access_ = access;
+  Mapping* current = mapping_.load(std::memory_order_relaxed);
+  if (current != NULL) {
+    madvise(current->base, current->capacity, madviseFlag(access));
+  }
+}
+
+const char* MappedFileIO::mappedAddress(const std::streamoff offset,
+                                        const std::size_t length) {
+  const std::size_t end = offset + length;
+  Mapping* current = mapping(end);
+  if (current == NULL || end > current->size.load(std::memory_order_acquire)) {
+    return NULL;
+  }
+  return current->base + offset;
+}
+
+}
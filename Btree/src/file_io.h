@@ -0,0 +1,429 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace badgerdb {
+
+/**
+ * @brief Ways of doing I/O on the file underlying a File object.
+ */
+enum class FileBackend {
+  /**
+   * A std::fstream, which has to seek before every read or write.  Accesses
+   * are serialized since the stream has a single file position.
+   */
+  STREAM,
+
+  /**
+   * A raw file descriptor accessed with pread() and pwrite(), which take the
+   * position as an argument.  Accesses to different pages run in parallel.
+   */
+  POSITIONAL,
+
+  /**
+   * A read-only memory mapping of the file, read with memcpy() and no system
+   * call at all.  Writes go through pwrite() on a descriptor sharing the
+   * page cache with the mapping.
+   */
+  MAPPED,
+
+  /**
+   * A file descriptor opened with O_DIRECT, so that pages are not held in the
+   * page cache of the kernel on top of the buffer pool.  Pages must be read
+   * and written at aligned addresses to skip copying, see DirectFileIO.
+   */
+  DIRECT
+};
+
+/**
+ * @brief Expected order in which the pages of a file are read, passed on to
+ *        the kernel to tune readahead.
+ */
+enum class FileAccess {
+  NORMAL,
+  SEQUENTIAL,
+  RANDOM
+};
+
+/**
+ * @brief Positional byte I/O on an open file, shared by all File objects using
+ *        the file.
+ *
+ * Reads and writes may be issued from several threads at once.  Besides the
+ * I/O itself, the object carries the lock which File uses to serialize
+ * changes to the structure of the file, such as allocating pages.
+ */
+class FileIO {
+ public:
+  /**
+   * Opens the given file with the given backend.  The file has to exist
+   * unless create_new is set, in which case it is created or truncated.
+   *
+   * @param name        Name of file.
+   * @param create_new  Whether to create a new, empty file.
+   * @param backend     How to do I/O on the file.
+   * @return  The open file, or NULL if it could not be opened.
+   */
+  static FileIO* open(const std::string& name, const bool create_new,
+                      const FileBackend backend);
+
+  /**
+   * Closes the file.
+   */
+  virtual ~FileIO() {}
+
+  /**
+   * Returns the backend the file was opened with.
+   */
+  virtual FileBackend backend() const = 0;
+
+  /**
+   * Reads bytes from the file.  Bytes past the end of the file read as zero.
+   *
+   * @param data    Receives the bytes read.
+   * @param length  Number of bytes to read.
+   * @param offset  Position in the file to read from.
+   * @throws  FileIOException  If the operating system fails the read.
+   */
+  virtual void read(char* data, const std::size_t length,
+                    const std::streamoff offset) = 0;
+
+  /**
+   * Writes bytes to the file, extending it if needed.  The bytes may stay in
+   * memory buffers until sync() is called or the file is closed.
+   *
+   * @param data    Bytes to write.
+   * @param length  Number of bytes to write.
+   * @param offset  Position in the file to write to.
+   * @throws  FileIOException  If the operating system fails the write.
+   */
+  virtual void write(const char* data, const std::size_t length,
+                     const std::streamoff offset) = 0;
+
+  /**
+   * Returns the current size of the file in bytes.
+   */
+  virtual std::streamoff size() = 0;
+
+  /**
+   * Makes the bytes written so far durable, waiting until they are on the
+   * device.
+   *
+   * @return  False if the file could not be synced.
+   */
+  virtual bool sync() = 0;
+
+  /**
+   * Allocates disk space for a range of the file without writing it.
+   *
+   * @param offset  Start of the range.
+   * @param length  Length of the range in bytes.
+   * @return  True if the space was allocated; false if the filesystem does
+   *          not support preallocation.
+   */
+  virtual bool reserve(const std::streamoff offset,
+                       const std::streamoff length) = 0;
+
+  /**
+   * Tells the kernel in which order the file is going to be read.
+   */
+  virtual void advise(const FileAccess access) = 0;
+
+  /**
+   * Returns the file descriptor of the file for I/O done outside of this
+   * object, or -1 if the file has none.
+   */
+  virtual int descriptor() const { return -1; }
+
+  /**
+   * Returns true if the given read or write may be done directly on
+   * descriptor(), outside of this object.
+   *
+   * @param data    Memory read into or written from.
+   * @param length  Number of bytes.
+   * @param offset  Position in the file.
+   */
+  virtual bool acceptsDirectly(const char* data, const std::size_t length,
+                               const std::streamoff offset) const {
+    return descriptor() >= 0;
+  }
+
+  /**
+   * Returns the address at which a range of the file is mapped in memory, or
+   * NULL if the file is not mapped or the range lies past its end.  The
+   * address stays valid until the file is closed, and the bytes there change
+   * when the range is written.
+   *
+   * @param offset  Start of the range.
+   * @param length  Length of the range in bytes.
+   */
+  virtual const char* mappedAddress(const std::streamoff offset,
+                                    const std::size_t length) {
+    return NULL;
+  }
+
+  /**
+   * Returns the lock serializing changes to the structure of the file.  It is
+   * recursive since such changes are made of smaller ones which lock it too.
+   */
+  std::recursive_mutex& structureMutex() { return structure_mutex_; }
+
+ private:
+  /**
+   * Lock serializing changes to the structure of the file.
+   */
+  std::recursive_mutex structure_mutex_;
+};
+
+/**
+ * @brief FileIO through a std::fstream.
+ */
+class StreamFileIO : public FileIO {
+ public:
+  /**
+   * Opens the file, see FileIO::open().  Check isOpen() afterwards.
+   */
+  StreamFileIO(const std::string& name, const bool create_new);
+
+  /**
+   * Returns true if the file was opened.
+   */
+  bool isOpen() const { return stream_.is_open(); }
+
+  FileBackend backend() const { return FileBackend::STREAM; }
+  void read(char* data, const std::size_t length, const std::streamoff offset);
+  void write(const char* data, const std::size_t length,
+             const std::streamoff offset);
+  std::streamoff size();
+  bool sync();
+  bool reserve(const std::streamoff offset, const std::streamoff length);
+  void advise(const FileAccess access);
+
+ private:
+  /**
+   * Name of the file, needed to preallocate space and to sync.
+   */
+  std::string name_;
+
+  /**
+   * Stream for the file.
+   */
+  std::fstream stream_;
+
+  /**
+   * Lock held from every seek until the read or write following it.
+   */
+  std::mutex stream_mutex_;
+};
+
+/**
+ * @brief FileIO through pread() and pwrite() on a file descriptor.
+ */
+class PositionalFileIO : public FileIO {
+ public:
+  /**
+   * Opens the file, see FileIO::open().  Check isOpen() afterwards.
+   */
+  PositionalFileIO(const std::string& name, const bool create_new);
+
+  /**
+   * Closes the file descriptor.
+   */
+  ~PositionalFileIO();
+
+  /**
+   * Returns true if the file was opened.
+   */
+  bool isOpen() const { return fd_ >= 0; }
+
+  int descriptor() const { return fd_; }
+
+  FileBackend backend() const { return FileBackend::POSITIONAL; }
+  void read(char* data, const std::size_t length, const std::streamoff offset);
+  void write(const char* data, const std::size_t length,
+             const std::streamoff offset);
+  std::streamoff size();
+  bool sync();
+  bool reserve(const std::streamoff offset, const std::streamoff length);
+  void advise(const FileAccess access);
+
+ private:
+  /**
+   * File descriptor of the file, negative if it could not be opened.
+   */
+  int fd_;
+};
+
+/**
+ * @brief FileIO through pread() and pwrite() on a file descriptor opened with
+ *        O_DIRECT.
+ *
+ * Direct I/O needs the memory address, the length and the file position all
+ * to be multiples of ALIGNMENT.  Such reads and writes go straight to the
+ * device; any other goes through an aligned buffer covering the blocks
+ * involved, writes reading those blocks first.  If the filesystem does not
+ * support O_DIRECT, the file is opened without it.
+ */
+class DirectFileIO : public FileIO {
+ public:
+  /**
+   * Alignment in bytes of direct reads and writes.  This is the logical block
+   * size of common devices at most, and the page size of the memory.
+   */
+  static const std::size_t ALIGNMENT = 4096;
+
+  /**
+   * Opens the file, see FileIO::open().  Check isOpen() afterwards.
+   */
+  DirectFileIO(const std::string& name, const bool create_new);
+
+  /**
+   * Closes the file descriptor.
+   */
+  ~DirectFileIO();
+
+  /**
+   * Returns true if the file was opened.
+   */
+  bool isOpen() const { return fd_ >= 0; }
+
+  /**
+   * Returns true if the file bypasses the page cache of the kernel.
+   */
+  bool isDirect() const { return direct_; }
+
+  int descriptor() const { return fd_; }
+  bool acceptsDirectly(const char* data, const std::size_t length,
+                       const std::streamoff offset) const;
+
+  FileBackend backend() const { return FileBackend::DIRECT; }
+  void read(char* data, const std::size_t length, const std::streamoff offset);
+  void write(const char* data, const std::size_t length,
+             const std::streamoff offset);
+  std::streamoff size();
+  bool sync();
+  bool reserve(const std::streamoff offset, const std::streamoff length);
+  void advise(const FileAccess access);
+
+ private:
+  /**
+   * File descriptor of the file, negative if it could not be opened.
+   */
+  int fd_;
+
+  /**
+   * True if the file was opened with O_DIRECT.
+   */
+  bool direct_;
+
+  /**
+   * Lock held over a write through the aligned buffer, since it rewrites
+   * bytes around the ones written.
+   */
+  std::mutex unaligned_mutex_;
+};
+
+/**
+ * @brief FileIO reading from a memory mapping of the file.
+ *
+ * The mapping is made larger than the file, so that the file can grow into it
+ * without remapping.  Once the file outgrows it, a mapping of twice the size
+ * replaces it.  Replaced mappings are kept until the file is closed, so that
+ * addresses handed out by mappedAddress() stay valid.
+ */
+class MappedFileIO : public FileIO {
+ public:
+  /**
+   * Opens the file, see FileIO::open().  Check isOpen() afterwards.
+   */
+  MappedFileIO(const std::string& name, const bool create_new);
+
+  /**
+   * Unmaps the file and closes the file descriptor.
+   */
+  ~MappedFileIO();
+
+  /**
+   * Returns true if the file was opened.
+   */
+  bool isOpen() const { return fd_ >= 0; }
+
+  int descriptor() const { return fd_; }
+
+  FileBackend backend() const { return FileBackend::MAPPED; }
+  void read(char* data, const std::size_t length, const std::streamoff offset);
+  void write(const char* data, const std::size_t length,
+             const std::streamoff offset);
+  std::streamoff size();
+  bool sync();
+  bool reserve(const std::streamoff offset, const std::streamoff length);
+  void advise(const FileAccess access);
+  const char* mappedAddress(const std::streamoff offset,
+                            const std::size_t length);
+
+ private:
+  /**
+   * @brief One mapping of the file.
+   */
+  struct Mapping {
+    /**
+     * Address of the start of the file.
+     */
+    char* base;
+
+    /**
+     * Length of the mapping in bytes.
+     */
+    std::size_t capacity;
+
+    /**
+     * Size of the file when it was last checked.  Only bytes before this may
+     * be read, the rest of the mapping faults.
+     */
+    std::atomic<std::size_t> size;
+  };
+
+  /**
+   * Returns the mapping, making sure that it covers the given number of bytes
+   * if the file is large enough.  Returns NULL if the file is empty.
+   */
+  Mapping* mapping(const std::size_t needed);
+
+  /**
+   * File descriptor of the file, negative if it could not be opened.
+   */
+  int fd_;
+
+  /**
+   * Current mapping, NULL until the file is first read.
+   */
+  std::atomic<Mapping*> mapping_;
+
+  /**
+   * Mappings replaced by larger ones.
+   */
+  std::vector<Mapping*> old_mappings_;
+
+  /**
+   * Lock for growing and replacing the mapping.
+   */
+  std::mutex map_mutex_;
+
+  /**
+   * Access pattern applied to new mappings.
+   */
+  FileAccess access_;
+};
+
+}
@@ -13,20 +13,17 @@ namespace badgerdb {
 FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
 {
   file = new PageFile(name, false);	//dont create new file
+  file->adviseAccess(FileAccess::SEQUENTIAL);
 	bufMgr = bufferMgr;
-	curDirtyFlag = false;
-  curPage = NULL;
 	filePageIter = file->begin();
 }
 
 FileScan::~FileScan()
 {
   // generally must unpin last page of the scan
-  if (curPage != NULL)
+  if (curPage.isValid())
   {
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-		curDirtyFlag = false;
+    curPage.release();
     filePageIter = file->begin();
   }
   bufMgr->flushFile(file);
@@ -43,7 +40,7 @@ void FileScan::scanNext(RecordId& outRid)
 	}
 
   // special case of the first record of the first page of the file
-  if (curPage == NULL)
+  if (!curPage.isValid())
   {
     // need to get the first page of the file
 		filePageIter = file->begin();
@@ -53,8 +50,7 @@ void FileScan::scanNext(RecordId& outRid)
 		}
 	 
 		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
-		curDirtyFlag = false;
+    curPage = bufMgr->readPage(file, (*filePageIter).page_number());
 
 		// get the first record off the page
     pageRecordIter = curPage->begin(); 
@@ -76,19 +72,16 @@ void FileScan::scanNext(RecordId& outRid)
   while (pageRecordIter == curPage->end())
   {
     // unpin the current page
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
-    curPage = NULL;
-    curDirtyFlag = false;
+    curPage.release();
 
     filePageIter++;
     if (filePageIter == file->end())
     {
-      curPage = NULL;
 			throw EndOfFileException();
     }
 
     // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+    curPage = bufMgr->readPage(file, (*filePageIter).page_number());
 
     // get the first record off the page
     pageRecordIter = curPage->begin(); 
@@ -114,7 +107,7 @@ std::string FileScan::getRecord()
 // mark current page of scan dirty
 void FileScan::markDirty()
 {
-  curDirtyFlag = true;
+  curPage.markDirty();
 }
 
 }
@@ -49,17 +49,12 @@ class FileScan
 	BufMgr				*bufMgr;
 
   /**
-   * Current page being scanned.
+   * Handle pinning the current page being scanned.
    */
-  Page*         curPage;
+  PageHandle    curPage;
 
   FileIterator  filePageIter;
   PageIterator  pageRecordIter;
-
-  /**
-   * True if page has been updated
-   */
-  bool  	      curDirtyFlag;
 };
 
 }
@@ -0,0 +1,277 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "io_engine.h"
+
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace badgerdb {
+
+IoEngine* IoEngine::create(const std::uint32_t depth) {
+  UringIoEngine* engine = new UringIoEngine(depth);
+  if (engine->isOpen()) {
+    return engine;
+  }
+  // no io_uring in this kernel, or it is not allowed in this process
+  delete engine;
+  return new SyncIoEngine();
+}
+
+void SyncIoEngine::read(FileIO& io, char* data, const std::size_t length,
+                        const std::streamoff offset) {
+  io.read(data, length, offset);
+}
+
+void SyncIoEngine::write(FileIO& io, const char* data,
+                         const std::size_t length,
+                         const std::streamoff offset) {
+  io.write(data, length, offset);
+}
+
+UringIoEngine::UringIoEngine(const std::uint32_t depth)
+    : ring_fd_(-1), sq_ring_(MAP_FAILED), sq_ring_size_(0),
+      cq_ring_(MAP_FAILED), cq_ring_size_(0), sqes_(MAP_FAILED),
+      sqes_size_(0), entries_(0), unsubmitted_(0), failed_(false) {
+  struct io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  const long fd = syscall(__NR_io_uring_setup, depth, &params);
+  if (fd < 0) {
+    return;
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(std::uint32_t);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap && cq_ring_size_ > sq_ring_size_) {
+    sq_ring_size_ = cq_ring_size_;
+  }
+  sq_ring_ = mmap(NULL, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+  if (single_mmap) {
+    cq_ring_ = sq_ring_;
+    cq_ring_size_ = 0;
+  } else if (sq_ring_ != MAP_FAILED) {
+    cq_ring_ = mmap(NULL, cq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+  }
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  if (sq_ring_ != MAP_FAILED && cq_ring_ != MAP_FAILED) {
+    sqes_ = mmap(NULL, sqes_size_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+  }
+  if (sqes_ == MAP_FAILED) {
+    ::close(fd);
+    return;
+  }
+
+  char* sq = static_cast<char*>(sq_ring_);
+  sq_head_ = reinterpret_cast<std::uint32_t*>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<std::uint32_t*>(sq + params.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<std::uint32_t*>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<std::uint32_t*>(sq + params.sq_off.array);
+  char* cq = static_cast<char*>(cq_ring_);
+  cq_head_ = reinterpret_cast<std::uint32_t*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<std::uint32_t*>(cq + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<std::uint32_t*>(cq + params.cq_off.ring_mask);
+  cqes_ = cq + params.cq_off.cqes;
+
+  // the completion queue is at least as large as the submission queue, so
+  // limiting the operations in flight to the latter keeps it from overflowing
+  entries_ = params.sq_entries;
+  operations_.resize(entries_);
+  for (std::uint32_t i = entries_; i > 0; i--) {
+    free_slots_.push_back(i - 1);
+  }
+  ring_fd_ = fd;
+}
+
+UringIoEngine::~UringIoEngine() {
+  if (ring_fd_ >= 0) {
+    wait();
+  }
+  if (sqes_ != MAP_FAILED) {
+    munmap(sqes_, sqes_size_);
+  }
+  if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+    munmap(cq_ring_, cq_ring_size_);
+  }
+  if (sq_ring_ != MAP_FAILED) {
+    munmap(sq_ring_, sq_ring_size_);
+  }
+  if (ring_fd_ >= 0) {
+    ::close(ring_fd_);
+  }
+}
+
+void UringIoEngine::read(FileIO& io, char* data, const std::size_t length,
+                         const std::streamoff offset) {
+  queue(io, data, length, offset, false /* write */);
+}
+
+void UringIoEngine::write(FileIO& io, const char* data,
+                          const std::size_t length,
+                          const std::streamoff offset) {
+  queue(io, const_cast<char*>(data), length, offset, true /* write */);
+}
+
+void UringIoEngine::queue(FileIO& io, char* data, const std::size_t length,
+                          const std::streamoff offset, const bool write) {
+  if (failed_ || !io.acceptsDirectly(data, length, offset)) {
+    if (write) {
+      io.write(data, length, offset);
+    } else {
+      io.read(data, length, offset);
+    }
+    return;
+  }
+
+  // every slot is in flight, wait for one to come back
+  while (free_slots_.empty()) {
+    if (!enter(1)) {
+      fail();
+      queue(io, data, length, offset, write);
+      return;
+    }
+    reap();
+  }
+  const std::uint32_t slot = free_slots_.back();
+  free_slots_.pop_back();
+  Operation& operation = operations_[slot];
+  operation.io = &io;
+  operation.data = data;
+  operation.length = length;
+  operation.offset = offset;
+  operation.write = write;
+
+  const std::uint32_t tail = *sq_tail_;
+  const std::uint32_t index = tail & sq_mask_;
+  struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(sqes_) + index;
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+  sqe->fd = io.descriptor();
+  sqe->addr = reinterpret_cast<std::uint64_t>(data);
+  sqe->len = length;
+  sqe->off = offset;
+  sqe->user_data = slot;
+  sq_array_[index] = index;
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  ++unsubmitted_;
+}
+
+long UringIoEngine::enterRing(const std::uint32_t to_submit,
+                              const std::uint32_t min_complete) {
+  const unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+  return syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete,
+                 flags, NULL, 0);
+}
+
+bool UringIoEngine::enter(const std::uint32_t min_complete) {
+  for (;;) {
+    const long submitted = enterRing(unsubmitted_, min_complete);
+    if (submitted >= 0) {
+      unsubmitted_ -= submitted;
+      if (unsubmitted_ == 0 || min_complete > 0) {
+        return true;
+      }
+    } else if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      return false;
+    }
+  }
+}
+
+void UringIoEngine::fail() {
+  failed_ = true;
+
+  // entries the kernel has not taken yet are withdrawn; without another
+  // call into the kernel it never looks at them
+  const std::uint32_t head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  std::vector<std::uint32_t> withdrawn;
+  for (std::uint32_t i = head; i != *sq_tail_; ++i) {
+    const struct io_uring_sqe* sqe =
+        static_cast<const struct io_uring_sqe*>(sqes_) +
+        sq_array_[i & sq_mask_];
+    withdrawn.push_back(sqe->user_data);
+  }
+  __atomic_store_n(sq_tail_, head, __ATOMIC_RELEASE);
+  unsubmitted_ = 0;
+
+  // the kernel finishes the operations it took on its own; doing them again
+  // would race with it, or undo later writes to the same bytes
+  while (entries_ - free_slots_.size() > withdrawn.size()) {
+    reap();
+    if (entries_ - free_slots_.size() > withdrawn.size()) {
+      sched_yield();
+    }
+  }
+
+  free_slots_.insert(free_slots_.end(), withdrawn.begin(), withdrawn.end());
+  for (std::size_t i = 0; i < withdrawn.size(); ++i) {
+    const Operation& operation = operations_[withdrawn[i]];
+    if (operation.write) {
+      operation.io->write(operation.data, operation.length, operation.offset);
+    } else {
+      operation.io->read(operation.data, operation.length, operation.offset);
+    }
+  }
+}
+
+void UringIoEngine::reap() {
+  const std::uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  for (std::uint32_t head = *cq_head_; head != tail; ++head) {
+    const struct io_uring_cqe* cqe =
+        static_cast<const struct io_uring_cqe*>(cqes_) + (head & cq_mask_);
+    const std::uint32_t slot = cqe->user_data;
+    const Operation operation = operations_[slot];
+    const std::size_t done = cqe->res > 0 ? cqe->res : 0;
+
+    // the entry and the slot are given back first, so that an operation
+    // which fails synchronously below leaves neither behind
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    free_slots_.push_back(slot);
+    if (done < operation.length) {
+      // failed or short; finish synchronously, which also zero fills reads
+      // past the end of the file
+      if (operation.write) {
+        operation.io->write(operation.data + done, operation.length - done,
+                            operation.offset + done);
+      } else {
+        operation.io->read(operation.data + done, operation.length - done,
+                           operation.offset + done);
+      }
+    }
+  }
+}
+
+std::size_t UringIoEngine::poll() {
+  if (failed_) {
+    return 0;
+  }
+  if (unsubmitted_ > 0 && !enter(0)) {
+    fail();
+    return 0;
+  }
+  reap();
+  return entries_ - free_slots_.size();
+}
+
+void UringIoEngine::wait() {
+  while (!failed_ && free_slots_.size() < entries_) {
+    if (!enter(1)) {
+      fail();
+      return;
+    }
+    reap();
+  }
+}
+
+}
@@ -0,0 +1,239 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "file_io.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Engine for batches of reads and writes on files.
+ *
+ * Operations are queued with read() and write() and run in the background
+ * until wait() returns; the memory they read from or write to must stay valid
+ * until then.  Operations the file does not accept on its descriptor, such as
+ * any on files opened with the STREAM backend, or unaligned ones on files
+ * opened with the DIRECT backend, run synchronously when they are queued.
+ *
+ * @warning This class is not threadsafe.
+ */
+class IoEngine {
+ public:
+  /**
+   * Creates the best engine available: an io_uring engine if the kernel
+   * supports io_uring, otherwise one doing every operation synchronously.
+   *
+   * @param depth   Number of operations which may be in flight at once.
+   * @return  The new engine, owned by the caller.
+   */
+  static IoEngine* create(const std::uint32_t depth);
+
+  /**
+   * Waits for the operations in flight.
+   */
+  virtual ~IoEngine() {}
+
+  /**
+   * Returns true if operations run in the background.
+   */
+  virtual bool asynchronous() const = 0;
+
+  /**
+   * Queues a read.  Bytes past the end of the file read as zero.
+   *
+   * @param io      File to read from.
+   * @param data    Receives the bytes read.
+   * @param length  Number of bytes to read.
+   * @param offset  Position in the file to read from.
+   */
+  virtual void read(FileIO& io, char* data, const std::size_t length,
+                    const std::streamoff offset) = 0;
+
+  /**
+   * Queues a write.
+   *
+   * @param io      File to write to.
+   * @param data    Bytes to write.
+   * @param length  Number of bytes to write.
+   * @param offset  Position in the file to write to.
+   */
+  virtual void write(FileIO& io, const char* data, const std::size_t length,
+                     const std::streamoff offset) = 0;
+
+  /**
+   * Starts the queued operations and collects the ones completed, without
+   * waiting.
+   *
+   * @return  Number of operations still in flight.
+   */
+  virtual std::size_t poll() = 0;
+
+  /**
+   * Starts the queued operations and waits until all operations are done.
+   */
+  virtual void wait() = 0;
+};
+
+/**
+ * @brief IoEngine running every operation when it is queued.
+ */
+class SyncIoEngine : public IoEngine {
+ public:
+  bool asynchronous() const { return false; }
+  void read(FileIO& io, char* data, const std::size_t length,
+            const std::streamoff offset);
+  void write(FileIO& io, const char* data, const std::size_t length,
+             const std::streamoff offset);
+  std::size_t poll() { return 0; }
+  void wait() {}
+};
+
+/**
+ * @brief IoEngine submitting operations to an io_uring of the kernel.
+ *
+ * The ring is set up and driven with raw system calls, so no library is
+ * needed.  Operations which the kernel fails or completes only in part are
+ * finished synchronously, as are all operations once the ring itself fails.
+ */
+class UringIoEngine : public IoEngine {
+ public:
+  /**
+   * Sets up a ring.  Check isOpen() afterwards.
+   *
+   * @param depth   Number of submission queue entries.
+   */
+  explicit UringIoEngine(const std::uint32_t depth);
+
+  /**
+   * Waits for the operations in flight and tears down the ring.
+   */
+  ~UringIoEngine();
+
+  /**
+   * Returns true if the ring was set up.
+   */
+  bool isOpen() const { return ring_fd_ >= 0; }
+
+  bool asynchronous() const { return true; }
+  void read(FileIO& io, char* data, const std::size_t length,
+            const std::streamoff offset);
+  void write(FileIO& io, const char* data, const std::size_t length,
+             const std::streamoff offset);
+  std::size_t poll();
+  void wait();
+
+ protected:
+  /**
+   * Calls io_uring_enter on the ring, handing entries to the kernel and, if
+   * min_complete is not zero, waiting for that many completions.
+   *
+   * @param to_submit     Number of queued entries to hand to the kernel.
+   * @param min_complete  Number of completions to wait for.
+   * @return  Number of entries the kernel took, or -1 with errno set.
+   */
+  virtual long enterRing(const std::uint32_t to_submit,
+                         const std::uint32_t min_complete);
+
+ private:
+  /**
+   * @brief An operation in flight.
+   */
+  struct Operation {
+    FileIO* io;
+    char* data;
+    std::size_t length;
+    std::streamoff offset;
+    bool write;
+  };
+
+  /**
+   * Puts an operation into the submission queue, making room first if
+   * needed.
+   */
+  void queue(FileIO& io, char* data, const std::size_t length,
+             const std::streamoff offset, const bool write);
+
+  /**
+   * Hands the queued entries to the kernel, waiting for at least min_complete
+   * completions.
+   *
+   * @return  False if the kernel failed the call for good.
+   */
+  bool enter(const std::uint32_t min_complete);
+
+  /**
+   * Gives up on the ring after it failed.  Entries the kernel has not taken
+   * are withdrawn, the operations it did take are waited for, and only the
+   * withdrawn ones are then done synchronously, as is every later operation.
+   */
+  void fail();
+
+  /**
+   * Collects the completions posted by the kernel.  Operations the kernel
+   * failed or completed only in part are finished synchronously.
+   */
+  void reap();
+
+  /**
+   * File descriptor of the ring, negative if it could not be set up.
+   */
+  int ring_fd_;
+
+  /**
+   * Mappings of the submission and completion rings and of the submission
+   * queue entries.
+   */
+  void* sq_ring_;
+  std::size_t sq_ring_size_;
+  void* cq_ring_;
+  std::size_t cq_ring_size_;
+  void* sqes_;
+  std::size_t sqes_size_;
+
+  /**
+   * Fields of the rings shared with the kernel.
+   */
+  std::uint32_t* sq_head_;
+  std::uint32_t* sq_tail_;
+  std::uint32_t sq_mask_;
+  std::uint32_t* sq_array_;
+  std::uint32_t* cq_head_;
+  std::uint32_t* cq_tail_;
+  std::uint32_t cq_mask_;
+  void* cqes_;
+
+  /**
+   * Number of submission queue entries.
+   */
+  std::uint32_t entries_;
+
+  /**
+   * Number of entries queued but not yet handed to the kernel.
+   */
+  std::uint32_t unsubmitted_;
+
+  /**
+   * True once the ring has failed, see fail().
+   */
+  bool failed_;
+
+  /**
+   * Operations by the slot number passed to the kernel as user data.
+   */
+  std::vector<Operation> operations_;
+
+  /**
+   * Slots of operations_ which are not in flight.
+   */
+  std::vector<std::uint32_t> free_slots_;
+};
+
+}
@@ -5,7 +5,16 @@
  * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <thread>
 #include <vector>
+#include <sys/resource.h>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
@@ -19,6 +28,10 @@
 #include "exceptions/bad_opcodes_exception.h"
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/invalid_page_exception.h"
+#include "exceptions/file_io_exception.h"
+#include "exceptions/page_pinned_exception.h"
+#include "exceptions/buffer_exceeded_exception.h"
 
 #define checkPassFail(a, b) 																				\
 {																																		\
@@ -60,6 +73,31 @@ std::string dbRecord1;
 
 BufMgr * bufMgr = new BufMgr(100);
 
+// An io_uring engine whose calls into the kernel fail once asked to. The failing call lets the kernel take and
+// finish the first entry queued, then overwrites that entry's data, so an operation done again shows in the file
+class FailingUringIoEngine : public UringIoEngine
+{
+ public:
+    FailingUringIoEngine() : UringIoEngine(8), failing(false), failures(0), overwrite(NULL), overwriteLength(0) {}
+
+    bool failing;
+    int failures;
+    char* overwrite;
+    std::size_t overwriteLength;
+
+ protected:
+    long enterRing(const std::uint32_t to_submit, const std::uint32_t min_complete)
+    {
+        if (!failing)
+            return UringIoEngine::enterRing(to_submit, min_complete);
+        failures++;
+        if (to_submit > 0 && UringIoEngine::enterRing(1, 1) == 1 && overwrite != NULL)
+            memset(overwrite, 'b', overwriteLength);
+        errno = EIO;
+        return -1;
+    }
+};
+
 // -----------------------------------------------------------------------------
 // Forward declarations
 // -----------------------------------------------------------------------------
@@ -91,6 +129,33 @@ void test7();
 void test8();
 void test9();
 void test10();
+void test11();
+void test12();
+void test13();
+void test14();
+void test15();
+void test16();
+void test17();
+void test18();
+void test19();
+void test20();
+void test21();
+void test22();
+void test23();
+void test24();
+void test25();
+void test26();
+void test27();
+void test28();
+void test29();
+void test30();
+void test31();
+void test32();
+void test33();
+void test34();
+bool usedPagesInOrder(PageFile& pageFile, int expected);
+FileHeader readRawHeader(const std::string& fileName);
+int readRelationInOrder();
 void errorTests();
 void deleteRelation();
 
@@ -175,6 +240,54 @@ int main(int argc, char **argv)
 	std::cout << "Finish Test Nine" << std::endl;
 	test10();
 	std::cout << "Finish Test Ten" << std::endl;
+	test11();
+	std::cout << "Finish Test Eleven" << std::endl;
+	test12();
+	std::cout << "Finish Test Twelve" << std::endl;
+	test13();
+	std::cout << "Finish Test Thirteen" << std::endl;
+	test14();
+	std::cout << "Finish Test Fourteen" << std::endl;
+	test15();
+	std::cout << "Finish Test Fifteen" << std::endl;
+	test16();
+	std::cout << "Finish Test Sixteen" << std::endl;
+	test17();
+	std::cout << "Finish Test Seventeen" << std::endl;
+	test18();
+	std::cout << "Finish Test Eighteen" << std::endl;
+	test19();
+	std::cout << "Finish Test Nineteen" << std::endl;
+	test20();
+	std::cout << "Finish Test Twenty" << std::endl;
+	test21();
+	std::cout << "Finish Test Twenty One" << std::endl;
+	test22();
+	std::cout << "Finish Test Twenty Two" << std::endl;
+	test23();
+	std::cout << "Finish Test Twenty Three" << std::endl;
+	test24();
+	std::cout << "Finish Test Twenty Four" << std::endl;
+	test25();
+	std::cout << "Finish Test Twenty Five" << std::endl;
+	test26();
+	std::cout << "Finish Test Twenty Six" << std::endl;
+	test27();
+	std::cout << "Finish Test Twenty Seven" << std::endl;
+	test28();
+	std::cout << "Finish Test Twenty Eight" << std::endl;
+	test29();
+	std::cout << "Finish Test Twenty Nine" << std::endl;
+	test30();
+	std::cout << "Finish Test Thirty" << std::endl;
+	test31();
+	std::cout << "Finish Test Thirty One" << std::endl;
+	test32();
+	std::cout << "Finish Test Thirty Two" << std::endl;
+	test33();
+	std::cout << "Finish Test Thirty Three" << std::endl;
+	test34();
+	std::cout << "Finish Test Thirty Four" << std::endl;
 	errorTests();
 	std::cout << "Finish Error Test" << std::endl;
 
@@ -285,6 +398,1609 @@ void test10()
     testType(9);
     deleteRelation();
 }
+void test11()
+{
+    // Pin pages of a relation through page handles
+    // Every pin has to be released when its handle is moved, released or goes out of scope
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for page handles" << std::endl;
+    forwardCreateRelationInSize(300);
+    {
+        PageId firstPageNo = file1->getFirstPageNo();
+        PageHandle first = bufMgr->readPage(file1, firstPageNo);
+        PageHandle moved = std::move(first);
+        checkPassFail(first.isValid(), false)
+        checkPassFail(moved.getPageNo(), firstPageNo)
+
+        RecordId firstRid = {firstPageNo, 1};
+        RECORD myRec = *(reinterpret_cast<const RECORD*>(moved->getRecord(firstRid).data()));
+        checkPassFail(myRec.i, 0)
+
+        moved.release();
+        checkPassFail(moved.isValid(), false)
+        PageHandle scoped = bufMgr->readPage(file1, firstPageNo);
+    }
+    // flushFile throws PagePinnedException if any of the pins above leaked
+    bufMgr->flushFile(file1);
+    deleteRelation();
+}
+void test12()
+{
+    // Shrink and grow the buffer pool while an index on the relation is open
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for resizing the buffer pool" << std::endl;
+    randomlyCreateRelationInSize(10000);
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail(intScan(&index,300,GT,400,LT), 99)
+
+        bufMgr->resize(10);
+        checkPassFail(intScan(&index,25,GT,40,LT), 14)
+        checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+
+        bufMgr->resize(300);
+        checkPassFail(intScan(&index,-3,GT,3,LT), 3)
+        checkPassFail(intScan(&index,0,GTE,10000,LT), 10000)
+
+        bufMgr->resize(100);
+        checkPassFail(intScan(&index,996,GT,1001,LT), 4)
+    }
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+}
+void test13()
+{
+    // Cap the frames used by the relation and reserve frames for the index while it is built
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for buffer pool quotas" << std::endl;
+    randomlyCreateRelationInSize(10000);
+    const std::string indexName = relationName + ".0";
+    bufMgr->setFileQuota(relationName, 0, 5);
+    bufMgr->setFileQuota(indexName, 20, 0);
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        bool withinCap = bufMgr->getFileQuota(relationName).resident <= 5;
+        checkPassFail(withinCap, true)
+
+        checkPassFail(intScan(&index,25,GT,40,LT), 14)
+        checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+        withinCap = bufMgr->getFileQuota(relationName).resident <= 5;
+        checkPassFail(withinCap, true)
+    }
+    bufMgr->clearFileQuota(relationName);
+    bufMgr->clearFileQuota(indexName);
+    checkPassFail(bufMgr->getFileQuota(relationName).maxFrames, 0)
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+
+    // the pool keeps the quota and statistics of a file by its id, but a closed file's id goes to the next file
+    // opened, which must get its own
+    const std::string nameA = "relA.quotaA";
+    const std::string nameB = "relA.quotaB";
+    {
+        BufMgr pool(16);
+        pool.setReadahead(false);
+        pool.setFileQuota(nameB, 0, 1);
+        PageId pageNo;
+        FileId idA;
+        {
+            PageFile fileA = PageFile::create(nameA);
+            fileA.allocatePage(pageNo);
+            fileA.allocatePage(pageNo);
+            pool.readPage(&fileA, 1).release();
+            pool.readPage(&fileA, 2).release();
+            idA = fileA.id();
+            pool.flushFile(&fileA);
+        }
+        PageFile fileB = PageFile::create(nameB);
+        checkPassFail(fileB.id(), idA)
+        fileB.allocatePage(pageNo);
+        fileB.allocatePage(pageNo);
+        pool.readPage(&fileB, 1).release();
+        pool.readPage(&fileB, 2).release();
+        checkPassFail(pool.getFileQuota(nameB).resident, 1)
+        BufStatsSnapshot stats = pool.getStatsSnapshot();
+        checkPassFail(stats.files[nameA].misses, 2)
+        checkPassFail(stats.files[nameB].misses, 2)
+        checkPassFail(stats.files[nameB].evictions, 1)
+        pool.flushFile(&fileB);
+    }
+    File::remove(nameA);
+    File::remove(nameB);
+}
+void test14()
+{
+    // Buffer pool statistics are broken down by file and agree with the totals
+    // Scanning the relation in page order makes the buffer manager read ahead
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for buffer pool statistics" << std::endl;
+    forwardCreateRelationInSize(5000);
+    bufMgr->flushFile(file1);
+    bufMgr->clearBufStats();
+    {
+        BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
+        checkPassFail(intScan(&index,3000,GTE,4000,LT), 1000)
+    }
+    BufStatsSnapshot stats = bufMgr->getStatsSnapshot();
+    bool relationMissed = stats.files[relationName].misses > 0;
+    checkPassFail(relationMissed, true)
+    bool counted = stats.totals.hits + stats.totals.misses <= stats.totals.accesses;
+    checkPassFail(counted, true)
+    std::uint64_t pagesRead = stats.totals.misses + stats.totals.prefetches;
+    // a batch of pages read ahead is timed as one read
+    bool sampled = stats.readLatency.count > 0 && stats.readLatency.count < pagesRead;
+    checkPassFail(sampled, true)
+    bool ordered = stats.readLatency.percentile(50) <= stats.readLatency.percentile(99);
+    checkPassFail(ordered, true)
+    // the relation is scanned in page order, so most of its pages are read ahead
+    bool readAhead = stats.totals.prefetchHits > stats.files[relationName].misses;
+    checkPassFail(readAhead, true)
+    bufMgr->dumpStats(std::cout);
+
+    bufMgr->clearBufStats();
+    stats = bufMgr->getStatsSnapshot();
+    checkPassFail(stats.totals.accesses, 0)
+    checkPassFail(stats.files[relationName].misses, 0)
+    try
+    {
+        File::remove(intIndexName);
+    }
+    catch(FileNotFoundException e)
+    {
+    }
+    deleteRelation();
+
+    // read ahead starts on the third page of a run, the first page read from a file does not extend one
+    const std::string runName = "relA.run";
+    {
+        PageFile runFile = PageFile::create(runName);
+        PageId pageNo;
+        for (int i = 0; i < 20; i++)
+            runFile.allocatePage(pageNo);
+        bufMgr->clearBufStats();
+        bufMgr->readPage(&runFile, 1).release();
+        bufMgr->readPage(&runFile, 2).release();
+        checkPassFail(bufMgr->getStatsSnapshot().totals.prefetches, 0)
+        bufMgr->readPage(&runFile, 3).release();
+        bool started = bufMgr->getStatsSnapshot().totals.prefetches > 0;
+        checkPassFail(started, true)
+        bufMgr->flushFile(&runFile);
+    }
+    File::remove(runName);
+}
+void test15()
+{
+    // Save the pages resident in the buffer pool and load them back after the pool was emptied
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for saving and loading buffer pool residency" << std::endl;
+    const std::string residencyName = "relA.residency";
+    forwardCreateRelationInSize(5000);
+    bufMgr->flushFile(file1);
+    // pages read ahead would be saved as well
+    bufMgr->setReadahead(false);
+    std::vector<PageId> pageNos;
+    for (FileIterator iter = file1->begin(); iter != file1->end() && pageNos.size() < 8; ++iter)
+    {
+        pageNos.push_back((*iter).page_number());
+        bufMgr->readPage(file1, pageNos.back());
+    }
+    bufMgr->saveResidency(residencyName);
+    bufMgr->flushFile(file1);
+
+    std::vector<File*> files;
+    files.push_back(file1);
+    bufMgr->clearBufStats();
+    checkPassFail(bufMgr->loadResidency(residencyName, files), 8)
+    // the pages of the file come from disk as one batch, and do not count as read ahead
+    BufStatsSnapshot loadStats = bufMgr->getStatsSnapshot();
+    checkPassFail(loadStats.totals.diskreads, 8)
+    checkPassFail(loadStats.readLatency.count, 1)
+    checkPassFail(loadStats.totals.prefetches, 0)
+
+    // every page read now has to be served from the pool
+    bufMgr->clearBufStats();
+    for (std::size_t i = 0; i < pageNos.size(); i++)
+        bufMgr->readPage(file1, pageNos[i]);
+    checkPassFail(bufMgr->getBufStats().misses, 0)
+    checkPassFail(bufMgr->loadResidency(residencyName, files), 0)
+
+    // a page deleted since the list was saved is skipped, and the pages after it are still loaded
+    bufMgr->flushFile(file1);
+    file1->deletePage(pageNos[3]);
+    bufMgr->clearBufStats();
+    checkPassFail(bufMgr->loadResidency(residencyName, files), 7)
+    for (std::size_t i = 0; i < pageNos.size(); i++)
+    {
+        if (i != 3)
+            bufMgr->readPage(file1, pageNos[i]);
+    }
+    checkPassFail(bufMgr->getBufStats().misses, 0)
+    bufMgr->setReadahead(true);
+    bufMgr->flushFile(file1);
+    File::remove(residencyName);
+    deleteRelation();
+}
+void test16()
+{
+    // Grow a blob file by extents and check that its header reaches disk when it is closed
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for blob file extents" << std::endl;
+    const std::string blobName = "relA.blob";
+    PageId lastPageNo = 0;
+    {
+        BlobFile blob = BlobFile::create(blobName);
+        for (int i = 0; i < 40; i++)
+            blob.allocatePage(lastPageNo);
+        checkPassFail(lastPageNo, 40)
+
+        // space preallocated past the last page is not part of the file
+        bool thrown = false;
+        try
+        {
+            blob.readPage(lastPageNo + 1);
+        }
+        catch(InvalidPageException e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+    }
+    {
+        BlobFile blob = BlobFile::open(blobName);
+        PageId pageNo;
+        blob.allocatePage(pageNo);
+        checkPassFail(pageNo, 41)
+    }
+    File::remove(blobName);
+}
+void test17()
+{
+    // Optimistic reads validate until a page handle declares it modifies the page
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for optimistic reads" << std::endl;
+    forwardCreateRelationInSize(300);
+    bufMgr->flushFile(file1);
+    PageId firstPageNo = file1->getFirstPageNo();
+    OptimisticRead read;
+    // pages which are not in the buffer pool have to be pinned
+    checkPassFail(bufMgr->readOptimistic(file1, firstPageNo, read), false)
+    {
+        PageHandle page = bufMgr->readPage(file1, firstPageNo);
+        checkPassFail(bufMgr->readOptimistic(file1, firstPageNo, read), true)
+        RecordId firstRid = {firstPageNo, 1};
+        RECORD myRec = *(reinterpret_cast<const RECORD*>(read.page->getRecord(firstRid).data()));
+        checkPassFail(bufMgr->validate(read), true)
+        checkPassFail(myRec.i, 0)
+
+        page.markDirty();
+        checkPassFail(bufMgr->validate(read), false)
+        checkPassFail(bufMgr->readOptimistic(file1, firstPageNo, read), false)
+    }
+    checkPassFail(bufMgr->readOptimistic(file1, firstPageNo, read), true)
+    checkPassFail(bufMgr->validate(read), true)
+    deleteRelation();
+
+    // range scans descend through the non leaf nodes optimistically once they are in the buffer pool
+    forwardCreateRelationInSize(10000);
+    testType(4);
+    deleteRelation();
+}
+void test18()
+{
+    // Repeated pins of a page by one thread are counted locally, including past the number of local slots
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for thread local pin counts" << std::endl;
+    forwardCreateRelationInSize(3000);
+    bufMgr->flushFile(file1);
+    std::vector<PageHandle> handles;
+    {
+        FileIterator iter = file1->begin();
+        for (int i = 0; i < 12 && iter != file1->end(); i++, ++iter)
+        {
+            handles.push_back(bufMgr->readPage(file1, (*iter).page_number()));
+            handles.push_back(bufMgr->readPage(file1, (*iter).page_number()));
+        }
+    }
+    checkPassFail(handles.size(), 24)
+    bool pinned = false;
+    try
+    {
+        bufMgr->flushFile(file1);
+    }
+    catch(PagePinnedException e)
+    {
+        pinned = true;
+    }
+    checkPassFail(pinned, true)
+
+    // dropping one of the two pins keeps every page pinned
+    for (size_t i = 0; i < handles.size(); i += 2)
+        handles[i].release();
+    pinned = false;
+    try
+    {
+        bufMgr->flushFile(file1);
+    }
+    catch(PagePinnedException e)
+    {
+        pinned = true;
+    }
+    checkPassFail(pinned, true)
+
+    handles.clear();
+    // flushFile throws PagePinnedException if any of the pins above leaked
+    bufMgr->flushFile(file1);
+
+    // disposing of a pinned page drops its pins, so the next page in the frame is pinned afresh
+    PageId pageNo;
+    Page* page;
+    bufMgr->allocPage(file1, pageNo, page);
+    bufMgr->disposePage(file1, pageNo);
+    bufMgr->allocPage(file1, pageNo, page);
+    pinned = false;
+    try
+    {
+        bufMgr->flushFile(file1);
+    }
+    catch(PagePinnedException e)
+    {
+        pinned = true;
+    }
+    checkPassFail(pinned, true)
+    bufMgr->unPinPage(file1, pageNo, true);
+    bufMgr->flushFile(file1);
+    deleteRelation();
+
+    // the pins another thread remembers count neither for the next page in the frame nor for a later manager
+    // at the same address
+    const std::string pinsName = "relA.pins";
+    {
+        PageFile pinFile = PageFile::create(pinsName);
+        PageId first;
+        PageId second;
+        pinFile.allocatePage(first);
+        pinFile.allocatePage(second);
+        alignas(BufMgr) char storage[sizeof(BufMgr)];
+        BufMgr* pool = new (storage) BufMgr(4);
+        pool->setReadahead(false);
+        std::atomic<int> step(0);
+        std::thread other([&pool, &pinFile, &step, first, second]() {
+            Page* page;
+            pool->readPage(&pinFile, first, page);
+            step = 1;
+            while (step.load() != 2)
+                std::this_thread::yield();
+            pool->readPage(&pinFile, second, page);
+            step = 3;
+            while (step.load() != 4)
+                std::this_thread::yield();
+            pool->readPage(&pinFile, second, page);
+            step = 5;
+        });
+
+        // the frame of the disposed page holds the second page next
+        while (step.load() != 1)
+            std::this_thread::yield();
+        pool->disposePage(&pinFile, first);
+        step = 2;
+        while (step.load() != 3)
+            std::this_thread::yield();
+        pinned = false;
+        try
+        {
+            pool->flushFile(&pinFile);
+        }
+        catch(PagePinnedException e)
+        {
+            pinned = true;
+        }
+        checkPassFail(pinned, true)
+        pool->unPinPage(&pinFile, second, false);
+        pool->flushFile(&pinFile);
+
+        pool->~BufMgr();
+        pool = new (storage) BufMgr(4);
+        pool->setReadahead(false);
+        step = 4;
+        while (step.load() != 5)
+            std::this_thread::yield();
+        other.join();
+        pinned = false;
+        try
+        {
+            pool->flushFile(&pinFile);
+        }
+        catch(PagePinnedException e)
+        {
+            pinned = true;
+        }
+        checkPassFail(pinned, true)
+        pool->unPinPage(&pinFile, second, false);
+        pool->flushFile(&pinFile);
+        pool->~BufMgr();
+    }
+    File::remove(pinsName);
+}
+void test19()
+{
+    // Pages evicted from the pool come back from the compressed tier instead of disk
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for the compressed page tier" << std::endl;
+    Page page;
+    for (int i = 0; i < 80; i++)
+    {
+        sprintf(record1.s, "%05d string record", i);
+        record1.i = i;
+        record1.d = (double)i;
+        page.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+    }
+    std::string packed;
+    CompressedCache::compress(reinterpret_cast<const char*>(&page), Page::SIZE, packed);
+    bool smaller = packed.size() < Page::SIZE / 2;
+    checkPassFail(smaller, true)
+    Page unpacked;
+    checkPassFail(CompressedCache::decompress(packed.data(), packed.size(), reinterpret_cast<char*>(&unpacked), Page::SIZE), true)
+    checkPassFail(memcmp(&page, &unpacked, Page::SIZE), 0)
+    checkPassFail(CompressedCache::decompress(packed.data(), packed.size() / 2, reinterpret_cast<char*>(&unpacked), Page::SIZE), false)
+
+    forwardCreateRelationInSize(20000);
+    bufMgr->flushFile(file1);
+    bufMgr->setReadahead(false);
+    bufMgr->setCompressedCache(4 * 1024 * 1024);
+    bufMgr->clearBufStats();
+    // the relation has more pages than the pool has frames, so the second pass misses on all of them
+    checkPassFail(readRelationInOrder(), 20000)
+    checkPassFail(readRelationInOrder(), 20000)
+    BufStats stats = bufMgr->getBufStats();
+    bool stored = stats.compressedStores > 0;
+    checkPassFail(stored, true)
+    bool served = stats.compressedHits > stats.diskreads / 2;
+    checkPassFail(served, true)
+    bufMgr->setCompressedCache(0);
+    bufMgr->setReadahead(true);
+    deleteRelation();
+}
+void test20()
+{
+    // Pages evicted from the pool come back from the victim cache file instead of the relation file
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for the victim cache file" << std::endl;
+    const std::string cacheName = "relA.victim";
+    bool notCreated = false;
+    try
+    {
+        bufMgr->setVictimCache("relA.nosuchdir/" + cacheName, 100);
+    }
+    catch(FileNotFoundException e)
+    {
+        notCreated = true;
+    }
+    checkPassFail(notCreated, true)
+
+    forwardCreateRelationInSize(20000);
+    bufMgr->flushFile(file1);
+    bufMgr->setReadahead(false);
+    bufMgr->setVictimCache(cacheName, 1000);
+    checkPassFail(File::exists(cacheName), true)
+    bufMgr->clearBufStats();
+    checkPassFail(readRelationInOrder(), 20000)
+    checkPassFail(readRelationInOrder(), 20000)
+    BufStats stats = bufMgr->getBufStats();
+    bool stored = stats.victimStores > 0;
+    checkPassFail(stored, true)
+    bool served = stats.victimHits > stats.diskreads / 2;
+    checkPassFail(served, true)
+
+    // pages of a flushed file must not be served from the cache to a later file
+    bufMgr->flushFile(file1);
+    bufMgr->clearBufStats();
+    checkPassFail(readRelationInOrder(), 20000)
+    checkPassFail(bufMgr->getBufStats().victimHits, 0)
+
+    bufMgr->setVictimCache(cacheName, 0);
+    checkPassFail(File::exists(cacheName), false)
+    bufMgr->setReadahead(true);
+    deleteRelation();
+}
+void test21()
+{
+    // Pages written through the stream backend read back through the positional one, also from several threads
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for file backends" << std::endl;
+    const std::string fileName = "relA.backend";
+    const int numPages = 64;
+    std::vector<PageId> pageNos;
+    {
+        PageFile streamFile = PageFile::create(fileName, FileBackend::STREAM);
+        bool streamed = streamFile.backend() == FileBackend::STREAM;
+        checkPassFail(streamed, true)
+        for (int i = 0; i < numPages; i++)
+        {
+            PageId pageNo;
+            Page page = streamFile.allocatePage(pageNo);
+            record1.i = i;
+            page.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+            streamFile.writePage(pageNo, page);
+            pageNos.push_back(pageNo);
+        }
+    }
+
+    {
+        PageFile posFile = PageFile::open(fileName, FileBackend::POSITIONAL);
+        bool positional = posFile.backend() == FileBackend::POSITIONAL;
+        checkPassFail(positional, true)
+        {
+            // a file which is open already keeps its backend
+            PageFile sameFile = PageFile::open(fileName, FileBackend::STREAM);
+            bool kept = sameFile.backend() == FileBackend::POSITIONAL;
+            checkPassFail(kept, true)
+        }
+
+        // every thread rewrites its own pages while reading all of them
+        std::atomic<int> mismatches(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 4; t++)
+        {
+            threads.push_back(std::thread([&posFile, &pageNos, &mismatches, t]() {
+                for (int round = 0; round < 10; round++)
+                {
+                    for (int i = 0; i < numPages; i++)
+                    {
+                        Page page = posFile.readPage(pageNos[i]);
+                        RecordId rid = {pageNos[i], 1};
+                        std::string recordStr = page.getRecord(rid);
+                        const RECORD* myRec = reinterpret_cast<const RECORD*>(recordStr.data());
+                        if (myRec->i != i)
+                            mismatches++;
+                        if (i % 4 == t)
+                            posFile.writePage(pageNos[i], page);
+                    }
+                }
+            }));
+        }
+        for (size_t t = 0; t < threads.size(); t++)
+            threads[t].join();
+        checkPassFail(mismatches.load(), 0)
+
+        // reading past the end gives a zeroed page, which is free, instead of breaking the file
+        bool invalid = false;
+        try
+        {
+            posFile.readPage(numPages + 10);
+        }
+        catch(InvalidPageException e)
+        {
+            invalid = true;
+        }
+        checkPassFail(invalid, true)
+        checkPassFail(posFile.readPage(pageNos[0]).page_number(), pageNos[0])
+    }
+    File::remove(fileName);
+
+    // a write the operating system fails is reported, not dropped
+    std::unique_ptr<FileIO> full(FileIO::open("/dev/full", false, FileBackend::POSITIONAL));
+    if (full)
+    {
+        bool failed = false;
+        try
+        {
+            full->write(reinterpret_cast<const char*>(&record1), sizeof(record1), 0);
+        }
+        catch(FileIOException e)
+        {
+            failed = e.error() == ENOSPC;
+        }
+        checkPassFail(failed, true)
+    }
+}
+void test22()
+{
+    // A mapped file grows its mapping as pages are added and hands out pages without copying them
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for memory mapped files" << std::endl;
+    const std::string fileName = "relA.mapped";
+    {
+        PageFile mappedFile = PageFile::create(fileName, FileBackend::MAPPED);
+        mappedFile.adviseAccess(FileAccess::SEQUENTIAL);
+        // enough pages to outgrow the first mapping
+        const int numPages = 300;
+        std::vector<PageId> pageNos;
+        int mismatches = 0;
+        for (int i = 0; i < numPages; i++)
+        {
+            PageId pageNo;
+            Page page = mappedFile.allocatePage(pageNo);
+            record1.i = i;
+            page.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+            mappedFile.writePage(pageNo, page);
+            pageNos.push_back(pageNo);
+
+            RecordId rid = {pageNo, 1};
+            std::string recordStr = mappedFile.readPage(pageNo).getRecord(rid);
+            if (reinterpret_cast<const RECORD*>(recordStr.data())->i != i)
+                mismatches++;
+        }
+        checkPassFail(mismatches, 0)
+
+        const Page* mapped = mappedFile.mappedPage(pageNos[0]);
+        bool zeroCopy = mapped != NULL;
+        checkPassFail(zeroCopy, true)
+        checkPassFail(mapped->page_number(), pageNos[0])
+        // writes show through the mapping
+        Page page = mappedFile.readPage(pageNos[0]);
+        record1.i = 1000;
+        RecordId rid = {pageNos[0], 1};
+        page.updateRecord(rid, std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+        mappedFile.writePage(pageNos[0], page);
+        std::string recordStr = mapped->getRecord(rid);
+        checkPassFail(reinterpret_cast<const RECORD*>(recordStr.data())->i, 1000)
+
+        bool pastEnd = mappedFile.mappedPage(numPages + 10) == NULL;
+        checkPassFail(pastEnd, true)
+        // a file which is open already keeps its backend
+        PageFile sameFile = PageFile::open(fileName);
+        bool shared = sameFile.backend() == FileBackend::MAPPED;
+        checkPassFail(shared, true)
+    }
+    {
+        // pages of files which are not mapped have to be read
+        PageFile positionalFile = PageFile::open(fileName, FileBackend::POSITIONAL);
+        bool notMapped = positionalFile.mappedPage(positionalFile.getFirstPageNo()) == NULL;
+        checkPassFail(notMapped, true)
+    }
+    File::remove(fileName);
+}
+void test23()
+{
+    // Batches of pages written and read through the I/O engine, and pages read ahead in batches by the pool
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for batched I/O" << std::endl;
+    const std::string fileName = "relA.batch";
+    const int numPages = 100;
+    IoEngine* engine = IoEngine::create(16);
+    std::cout << "asynchronous I/O: " << engine->asynchronous() << std::endl;
+    {
+        PageFile pageFile = PageFile::create(fileName);
+        std::vector<PageId> pageNos(numPages);
+        std::vector<Page> pages(numPages);
+        std::vector<Page*> pagePtrs(numPages);
+        for (int i = 0; i < numPages; i++)
+        {
+            pages[i] = pageFile.allocatePage(pageNos[i]);
+            record1.i = i;
+            pages[i].insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+            pagePtrs[i] = &pages[i];
+        }
+        // more pages than the engine takes at once
+        pageFile.writePages(*engine, pageNos.data(), pagePtrs.data(), numPages);
+
+        std::vector<Page> readBack(numPages);
+        std::vector<Page*> readPtrs(numPages);
+        for (int i = 0; i < numPages; i++)
+            readPtrs[i] = &readBack[i];
+        checkPassFail(pageFile.readPages(*engine, pageNos.data(), readPtrs.data(), numPages), numPages)
+        int mismatches = 0;
+        for (int i = 0; i < numPages; i++)
+        {
+            RecordId rid = {pageNos[i], 1};
+            std::string recordStr = readBack[i].getRecord(rid);
+            if (reinterpret_cast<const RECORD*>(recordStr.data())->i != i)
+                mismatches++;
+        }
+        checkPassFail(mismatches, 0)
+
+        // a batch stops at the first page which is not in the file
+        pageFile.deletePage(pageNos[5]);
+        checkPassFail(pageFile.readPages(*engine, pageNos.data(), readPtrs.data(), numPages), 5)
+        PageId pastEnd[2] = {pageNos[0], pageNos[numPages - 1] + 10};
+        checkPassFail(pageFile.readPages(*engine, pastEnd, readPtrs.data(), 2), 1)
+        bool deleted = false;
+        try
+        {
+            pageFile.writePages(*engine, &pageNos[5], &pagePtrs[5], 1);
+        }
+        catch(InvalidPageException e)
+        {
+            deleted = true;
+        }
+        checkPassFail(deleted, true)
+    }
+    delete engine;
+    File::remove(fileName);
+
+    // when the ring fails, what the kernel took is waited for and only what it never took is done again
+    {
+        FailingUringIoEngine failing;
+        std::unique_ptr<FileIO> io(FileIO::open(fileName, true, FileBackend::POSITIONAL));
+        if (failing.isOpen() && io)
+        {
+            std::vector<char> first(4096, 'a');
+            std::vector<char> second(4096, 'c');
+            failing.write(*io, first.data(), first.size(), 0);
+            failing.write(*io, second.data(), second.size(), 4096);
+            failing.failing = true;
+            failing.overwrite = first.data();
+            failing.overwriteLength = first.size();
+            failing.wait();
+            checkPassFail(failing.failures, 1)
+
+            std::vector<char> readBack(8192);
+            io->read(readBack.data(), readBack.size(), 0);
+            const bool notRepeated = readBack[0] == 'a' && readBack[4095] == 'a';
+            checkPassFail(notRepeated, true)
+            const bool withdrawnDone = readBack[4096] == 'c' && readBack[8191] == 'c';
+            checkPassFail(withdrawnDone, true)
+
+            // later operations run synchronously, without calling into the kernel
+            failing.write(*io, second.data(), second.size(), 8192);
+            checkPassFail(failing.poll(), 0)
+            failing.wait();
+            checkPassFail(failing.failures, 1)
+            io->read(readBack.data(), 4096, 8192);
+            checkPassFail(readBack[0], 'c')
+        }
+    }
+    File::remove(fileName);
+
+    // a scan reads most pages ahead, and the pages come back intact
+    forwardCreateRelationInSize(20000);
+    bufMgr->flushFile(file1);
+    bufMgr->clearBufStats();
+    checkPassFail(readRelationInOrder(), 20000)
+    BufStats stats = bufMgr->getBufStats();
+    bool prefetched = stats.prefetches > stats.diskreads / 2;
+    checkPassFail(prefetched, true)
+    bufMgr->flushFile(file1);
+    deleteRelation();
+}
+void test24()
+{
+    // Pages of a file opened for direct I/O go through the pool from aligned frames, and the file reads the same
+    // through the other backends
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for direct I/O" << std::endl;
+    const std::string fileName = "relA.direct";
+    const int numPages = 40;
+    std::vector<PageId> pageNos(numPages);
+    {
+        PageFile directFile = PageFile::create(fileName, FileBackend::DIRECT);
+        bool direct = directFile.backend() == FileBackend::DIRECT;
+        checkPassFail(direct, true)
+        int unaligned = 0;
+        for (int i = 0; i < numPages; i++)
+        {
+            PageHandle page = bufMgr->allocPage(&directFile, pageNos[i]);
+            if (reinterpret_cast<std::uintptr_t>(page.get()) % Page::ALIGNMENT != 0)
+                unaligned++;
+            record1.i = i;
+            page->insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+            page.markDirty();
+        }
+        checkPassFail(unaligned, 0)
+        bufMgr->flushFile(&directFile);
+
+        int mismatches = 0;
+        for (int i = 0; i < numPages; i++)
+        {
+            PageHandle page = bufMgr->readPage(&directFile, pageNos[i]);
+            RecordId rid = {pageNos[i], 1};
+            std::string recordStr = page->getRecord(rid);
+            if (reinterpret_cast<const RECORD*>(recordStr.data())->i != i)
+                mismatches++;
+        }
+        checkPassFail(mismatches, 0)
+        bufMgr->flushFile(&directFile);
+
+        // pages on the stack are not aligned and go through a bounce buffer
+        Page page = directFile.readPage(pageNos[3]);
+        record1.i = 1000;
+        RecordId rid = {pageNos[3], 1};
+        page.updateRecord(rid, std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+        directFile.writePage(pageNos[3], page);
+        directFile.deletePage(pageNos[7]);
+    }
+    {
+        PageFile posFile = PageFile::open(fileName, FileBackend::POSITIONAL);
+        int count = 0;
+        for (FileIterator iter = posFile.begin(); iter != posFile.end(); ++iter)
+            count++;
+        checkPassFail(count, numPages - 1)
+        RecordId rid = {pageNos[3], 1};
+        std::string recordStr = posFile.readPage(pageNos[3]).getRecord(rid);
+        checkPassFail(reinterpret_cast<const RECORD*>(recordStr.data())->i, 1000)
+    }
+    File::remove(fileName);
+}
+void test25()
+{
+    // A checkpoint writes the dirty pages of the pool once and leaves them in the pool, then syncs the files
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for checkpoints" << std::endl;
+    const std::string fileName = "relA.checkpoint";
+    const int numPages = 20;
+    std::vector<PageId> pageNos(numPages);
+    {
+        PageFile streamFile = PageFile::create(fileName, FileBackend::STREAM);
+        bufMgr->clearBufStats();
+        for (int i = 0; i < numPages; i++)
+        {
+            PageHandle page = bufMgr->allocPage(&streamFile, pageNos[i]);
+            record1.i = i;
+            page->insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+            page.markDirty();
+        }
+        // a pinned page is written too
+        PageHandle pinned = bufMgr->readPage(&streamFile, pageNos[0]);
+        checkPassFail(bufMgr->checkpoint(), true)
+        checkPassFail(bufMgr->getBufStats().diskwrites, numPages)
+        checkPassFail(bufMgr->checkpoint(), true)
+        checkPassFail(bufMgr->getBufStats().diskwrites, numPages)
+
+        // the pages are on disk, where another stream sees them, and still in the pool
+        std::ifstream raw(fileName, std::ios::binary);
+        Page onDisk;
+        raw.seekg((std::streamoff) pageNos[numPages - 1] * Page::SIZE);
+        raw.read(reinterpret_cast<char*>(&onDisk), Page::SIZE);
+        const std::uint64_t diskreads = bufMgr->getBufStats().diskreads;
+        PageHandle page = bufMgr->readPage(&streamFile, pageNos[numPages - 1]);
+        checkPassFail(memcmp(&onDisk, page.get(), Page::SIZE), 0)
+        checkPassFail(bufMgr->getBufStats().diskreads, diskreads)
+        page.release();
+        pinned.release();
+        bufMgr->flushFile(&streamFile);
+        checkPassFail(bufMgr->getBufStats().diskwrites, numPages)
+        checkPassFail(streamFile.sync(), true)
+    }
+    File::remove(fileName);
+
+    // a file whose pages left the pool is still synced at the next checkpoint, even once it is closed
+    {
+        PageFile closedFile = PageFile::create(fileName);
+        PageId pageNo;
+        bufMgr->allocPage(&closedFile, pageNo).release();
+        bufMgr->flushFile(&closedFile);
+    }
+    checkPassFail(bufMgr->checkpoint(), true)
+    File::remove(fileName);
+
+    // the header of a file without pages in the pool is written too
+    {
+        PageFile idleFile = PageFile::create(fileName);
+        PageId pageNo;
+        idleFile.allocatePage(pageNo);
+        checkPassFail(readRawHeader(fileName).num_pages, 1)
+        checkPassFail(bufMgr->checkpoint(), true)
+        checkPassFail(readRawHeader(fileName).num_pages, 2)
+    }
+    File::remove(fileName);
+
+    // a file is synced through the objects registered for it, whatever its kind, or without any once closed
+    {
+        BlobFile blobFile = BlobFile::create(fileName);
+        PageId pageNo;
+        blobFile.allocatePage(pageNo);
+        checkPassFail(File::syncFile(fileName), true)
+        checkPassFail(readRawHeader(fileName).num_pages, 2)
+    }
+    checkPassFail(File::syncFile(fileName), true)
+    File::remove(fileName);
+    checkPassFail(File::syncFile(fileName), true)
+}
+void test26()
+{
+    // The header of a page file is kept in memory and reaches the disk at sync and close
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for cached file headers" << std::endl;
+    const std::string fileName = "relA.header";
+    const int numPages = 10;
+    {
+        PageFile pageFile = PageFile::create(fileName);
+        for (int i = 0; i < numPages; i++)
+        {
+            PageId pageNo;
+            pageFile.allocatePage(pageNo);
+        }
+        checkPassFail(readRawHeader(fileName).num_pages, 1)
+        checkPassFail(pageFile.sync(), true)
+        checkPassFail(readRawHeader(fileName).num_pages, numPages + 1)
+
+        PageId pageNo;
+        pageFile.allocatePage(pageNo);
+        // still checked against the header in memory
+        checkPassFail(pageFile.readPage(pageNo).page_number(), pageNo)
+        bool invalid = false;
+        try
+        {
+            pageFile.readPage(pageNo + 1);
+        }
+        catch(InvalidPageException e)
+        {
+            invalid = true;
+        }
+        checkPassFail(invalid, true)
+    }
+    checkPassFail(readRawHeader(fileName).num_pages, numPages + 2)
+    File::remove(fileName);
+}
+FileHeader readRawHeader(const std::string& fileName)
+{
+    // Reads the header of a file from disk, past any File object
+    FileHeader header;
+    std::ifstream raw(fileName, std::ios::binary);
+    raw.read(reinterpret_cast<char*>(&header), sizeof(header));
+    return header;
+}
+void test27()
+{
+    // New pages go to the tail of the used list and reused pages into their place in page number order, also
+    // after the file has been closed and opened again
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for page allocation" << std::endl;
+    const std::string fileName = "relA.alloc";
+    const int numPages = 2000;
+    {
+        PageFile pageFile = PageFile::create(fileName);
+        PageId pageNo = 0;
+        for (int i = 0; i < numPages; i++)
+            pageFile.allocatePage(pageNo);
+        checkPassFail(usedPagesInOrder(pageFile, numPages), true)
+        pageFile.deletePage(numPages);
+        pageFile.deletePage(1000);
+        pageFile.deletePage(1);
+        checkPassFail(usedPagesInOrder(pageFile, numPages - 3), true)
+        pageFile.allocatePage(pageNo);
+        checkPassFail(pageNo, 1)
+        checkPassFail(pageFile.getFirstPageNo(), 1)
+    }
+    checkPassFail(readRawHeader(fileName).last_used_page, numPages - 1)
+    {
+        PageFile pageFile = PageFile::open(fileName);
+        PageId pageNo = 0;
+        pageFile.allocatePage(pageNo);
+        checkPassFail(pageNo, 1000)
+        pageFile.allocatePage(pageNo);
+        checkPassFail(pageNo, numPages)
+        pageFile.allocatePage(pageNo);
+        checkPassFail(pageNo, numPages + 1)
+        checkPassFail(usedPagesInOrder(pageFile, numPages + 1), true)
+    }
+    File::remove(fileName);
+}
+void test28()
+{
+    // A batch of deletes unlinks runs of pages and scattered pages alike, keeping the used list in order
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for batched page deletion" << std::endl;
+    const std::string fileName = "relA.delete";
+    const int numPages = 3000;
+    {
+        PageFile pageFile = PageFile::create(fileName);
+        PageId pageNo = 0;
+        for (int i = 0; i < numPages; i++)
+            pageFile.allocatePage(pageNo);
+
+        std::vector<PageId> purged;
+        for (PageId i = 1; i <= 100; i++)
+            purged.push_back(i);
+        for (PageId i = 1500; i > 500; i--)
+            purged.push_back(i);
+        for (PageId i = 2001; i < numPages; i += 7)
+            purged.push_back(i);
+        purged.push_back(numPages);
+        purged.push_back(numPages - 1);
+        purged.push_back(1000);
+        pageFile.deletePages(purged.data(), purged.size());
+        const int deletedCount = 100 + 1000 + 143 + 2;
+        checkPassFail(usedPagesInOrder(pageFile, numPages - deletedCount), true)
+        checkPassFail(pageFile.getFirstPageNo(), 101)
+        checkPassFail(pageFile.sync(), true)
+        checkPassFail(readRawHeader(fileName).last_used_page, numPages - 2)
+        checkPassFail(readRawHeader(fileName).num_free_pages, deletedCount)
+
+        // a page which is not in use fails the whole batch
+        PageId invalid[2] = {200, 600};
+        bool thrown = false;
+        try
+        {
+            pageFile.deletePages(invalid, 2);
+        }
+        catch(InvalidPageException e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+        checkPassFail(usedPagesInOrder(pageFile, numPages - deletedCount), true)
+
+        // the deleted pages are reused in their place
+        for (int i = 0; i < deletedCount; i++)
+            pageFile.allocatePage(pageNo);
+        checkPassFail(usedPagesInOrder(pageFile, numPages), true)
+    }
+    File::remove(fileName);
+}
+void test29()
+{
+    // Records go to pages with room found through the free space map, including space freed by deleting records,
+    // and the map is kept across closing and opening the file, also past the part held by the header page
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for the free space map" << std::endl;
+    const std::string fileName = "relA.space";
+    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
+    std::vector<RecordId> rids;
+    {
+        PageFile pageFile = PageFile::create(fileName);
+        for (int i = 0; i < 1000; i++)
+            rids.push_back(pageFile.insertRecord(new_data));
+        // every page but the last is full
+        int perPage = 0;
+        while (rids[perPage].page_number == rids[0].page_number)
+            perPage++;
+        checkPassFail(rids.back().page_number, (PageId) ((1000 + perPage - 1) / perPage))
+        bool tooLarge = false;
+        try
+        {
+            pageFile.insertRecord(std::string(Page::DATA_SIZE, 'x'));
+        }
+        catch(InsufficientSpaceException e)
+        {
+            tooLarge = true;
+        }
+        checkPassFail(tooLarge, true)
+
+        // free two records on a page in the middle
+        Page page = pageFile.readPage(rids[200].page_number);
+        page.deleteRecord(rids[200]);
+        page.deleteRecord(rids[201]);
+        pageFile.writePage(rids[200].page_number, page);
+    }
+    {
+        PageFile pageFile = PageFile::open(fileName);
+        checkPassFail(pageFile.insertRecord(new_data).page_number, rids[200].page_number)
+        checkPassFail(pageFile.insertRecord(new_data).page_number, rids[200].page_number)
+        checkPassFail(pageFile.insertRecord(new_data).page_number, rids.back().page_number)
+    }
+    File::remove(fileName);
+
+    const int numPages = 16500;
+    const PageId firstKept = 16400;
+    {
+        PageFile pageFile = PageFile::create(fileName);
+        PageId pageNo;
+        for (int i = 0; i < numPages; i++)
+            pageFile.allocatePage(pageNo);
+        std::vector<PageId> purged;
+        for (PageId i = 1; i < firstKept; i++)
+            purged.push_back(i);
+        pageFile.deletePages(purged.data(), purged.size());
+    }
+    checkPassFail(readRawHeader(fileName).first_map_page, numPages + 1)
+    {
+        PageFile pageFile = PageFile::open(fileName);
+        bool mapHidden = false;
+        try
+        {
+            pageFile.readPage(numPages + 1);
+        }
+        catch(InvalidPageException e)
+        {
+            mapHidden = true;
+        }
+        checkPassFail(mapHidden, true)
+        checkPassFail(usedPagesInOrder(pageFile, numPages - firstKept + 1), true)
+        checkPassFail(pageFile.insertRecord(new_data).page_number, firstKept)
+    }
+    File::remove(fileName);
+
+    // inserting through the buffer pool changes the frame holding the page, which takes the record to disk
+    {
+        PageFile pageFile = PageFile::create(fileName);
+        const RecordId first = bufMgr->insertRecord(&pageFile, new_data);
+        RecordId second;
+        {
+            PageHandle page = bufMgr->readPage(&pageFile, first.page_number);
+            second = bufMgr->insertRecord(&pageFile, new_data);
+            checkPassFail(second.page_number, first.page_number)
+            const bool resident = page->getRecord(second) == new_data;
+            checkPassFail(resident, true)
+        }
+        // the largest record an empty page takes goes to a new page, one byte more does not fit at all
+        const RecordId largest = bufMgr->insertRecord(&pageFile, std::string(Page::MAX_RECORD_SIZE, 'x'));
+        bool newPage = largest.page_number != first.page_number;
+        checkPassFail(newPage, true)
+        bool tooLarge = false;
+        try
+        {
+            bufMgr->insertRecord(&pageFile, std::string(Page::MAX_RECORD_SIZE + 1, 'x'));
+        }
+        catch(InsufficientSpaceException e)
+        {
+            tooLarge = true;
+        }
+        checkPassFail(tooLarge, true)
+        bufMgr->flushFile(&pageFile);
+        const bool written = pageFile.readPage(first.page_number).getRecord(second) == new_data;
+        checkPassFail(written, true)
+    }
+    File::remove(fileName);
+}
+void test30()
+{
+    // Pages deleted from a blob file are recycled, newest first, before the file grows, also after reopening it
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for recycling blob file pages" << std::endl;
+    const std::string fileName = "relA.blob";
+    const int numPages = 10;
+    {
+        BlobFile blob = BlobFile::create(fileName);
+        PageId pageNo;
+        RecordId blobRid;
+        for (int i = 0; i < numPages; i++)
+        {
+            Page page = blob.allocatePage(pageNo);
+            blobRid = page.insertRecord("blob page");
+            blob.writePage(pageNo, page);
+        }
+        blob.deletePage(3);
+        blob.deletePage(7);
+        bool thrown = false;
+        try
+        {
+            blob.deletePage(7);
+        }
+        catch(InvalidPageException e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+        thrown = false;
+        try
+        {
+            blob.deletePage(numPages + 1);
+        }
+        catch(InvalidPageException e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+
+        blob.allocatePage(pageNo);
+        checkPassFail(pageNo, 7)
+        blob.allocatePage(pageNo);
+        checkPassFail(pageNo, 3)
+        blob.allocatePage(pageNo);
+        checkPassFail(pageNo, numPages + 1)
+        blob.deletePage(5);
+        thrown = false;
+        try
+        {
+            blob.readPage(5);
+        }
+        catch(InvalidPageException e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+        // neighbours of a deleted page are left alone
+        const bool neighbourKept = blob.readPage(4).getRecord(blobRid) == "blob page";
+        checkPassFail(neighbourKept, true)
+    }
+    checkPassFail(readRawHeader(fileName).num_free_pages, 1)
+    checkPassFail(readRawHeader(fileName).first_free_page, 5)
+    {
+        BlobFile blob = BlobFile::open(fileName);
+        bool thrown = false;
+        try
+        {
+            blob.deletePage(5);
+        }
+        catch(InvalidPageException e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+        thrown = false;
+        try
+        {
+            blob.readPage(5);
+        }
+        catch(InvalidPageException e)
+        {
+            thrown = true;
+        }
+        checkPassFail(thrown, true)
+        PageId pageNo;
+        blob.allocatePage(pageNo);
+        checkPassFail(pageNo, 5)
+        blob.allocatePage(pageNo);
+        checkPassFail(pageNo, numPages + 2)
+    }
+    checkPassFail(readRawHeader(fileName).num_free_pages, 0)
+    checkPassFail(readRawHeader(fileName).num_pages, numPages + 3)
+    File::remove(fileName);
+}
+void test31()
+{
+    // File objects for the same open file share its id, so iterators over either compare equal, and the id of a
+    // closed file is given to the next file opened
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for file ids" << std::endl;
+    const std::string nameA = "relA.idA";
+    const std::string nameB = "relA.idB";
+    FileId idA;
+    FileId idB;
+    {
+        PageFile fileA = PageFile::create(nameA);
+        PageFile copyA = PageFile::open(nameA);
+        PageFile fileB = PageFile::create(nameB);
+        checkPassFail(copyA.id(), fileA.id())
+        const bool distinct = fileB.id() != fileA.id();
+        checkPassFail(distinct, true)
+        PageId pageNo;
+        fileA.allocatePage(pageNo);
+        const bool sameBegin = fileA.begin() == copyA.begin();
+        checkPassFail(sameBegin, true)
+        const bool sameEnd = fileA.end() == copyA.end();
+        checkPassFail(sameEnd, true)
+        const bool otherFileEnd = fileA.end() != fileB.end();
+        checkPassFail(otherFileEnd, true)
+        idA = fileA.id();
+        idB = fileB.id();
+    }
+    {
+        PageFile fileB = PageFile::open(nameB);
+        const bool reused = fileB.id() == idA || fileB.id() == idB;
+        checkPassFail(reused, true)
+        PageFile fileA = PageFile::open(nameA);
+        const bool distinct = fileA.id() != fileB.id();
+        checkPassFail(distinct, true)
+
+        // the pool finds the pages of a file assigned the same file again, also once its hash table is rebuilt
+        BufMgr pool(16);
+        const PageId pageNo = fileA.getFirstPageNo();
+        pool.readPage(&fileA, pageNo).release();
+        const FileId id = fileA.id();
+        fileA = PageFile::open(nameA);
+        checkPassFail(fileA.id(), id)
+        pool.readPage(&fileA, pageNo).release();
+        checkPassFail(pool.getBufStats().hits, 1)
+        pool.resize(64);
+        pool.readPage(&fileA, pageNo).release();
+        checkPassFail(pool.getBufStats().hits, 2)
+        pool.flushFile(&fileA);
+    }
+    File::remove(nameA);
+    File::remove(nameB);
+}
+void test32()
+{
+    // A full pool evicts a batch of frames per sweep and hands out the others from its free list. Pinned frames
+    // and frames reserved for a file are passed over, and a capped file only replaces its own pages
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for batch eviction" << std::endl;
+    const std::string nameA = "relA.evictA";
+    const std::string nameB = "relA.evictB";
+    const std::uint32_t numFrames = 64;
+    const std::uint32_t batch = numFrames / 16;
+    {
+        PageFile fileA = PageFile::create(nameA);
+        PageFile fileB = PageFile::create(nameB);
+        PageId pageNo;
+        for (std::uint32_t i = 0; i < 2 * numFrames; i++)
+        {
+            fileA.allocatePage(pageNo);
+            fileB.allocatePage(pageNo);
+        }
+        BufMgr pool(numFrames);
+        pool.setReadahead(false);
+
+        // pages are read straight into their frames
+        bool numbered = true;
+        for (PageId i = 1; i <= numFrames; i++)
+        {
+            PageHandle page = pool.readPage(&fileA, i);
+            if (page->page_number() != i)
+                numbered = false;
+        }
+        checkPassFail(numbered, true)
+        checkPassFail(pool.getBufStats().cleanEvictions, 0)
+
+        // the first miss in the full pool evicts a batch, the next misses take the frames freed with it
+        pool.readPage(&fileA, numFrames + 1).release();
+        checkPassFail(pool.getBufStats().cleanEvictions, batch)
+        for (PageId i = numFrames + 2; i <= numFrames + batch; i++)
+            pool.readPage(&fileA, i).release();
+        checkPassFail(pool.getBufStats().cleanEvictions, batch)
+        pool.readPage(&fileA, numFrames + batch + 1).release();
+        checkPassFail(pool.getBufStats().cleanEvictions, 2 * batch)
+
+        // a capped file replaces its own pages once it holds its share
+        pool.setFileQuota(nameB, 0, 2);
+        pool.readPage(&fileB, 1).release();
+        pool.readPage(&fileB, 2).release();
+        const std::uint64_t evictionsA = pool.getStatsSnapshot().files[nameA].evictions;
+        for (PageId i = 3; i <= 2 * numFrames; i++)
+            pool.readPage(&fileB, i).release();
+        checkPassFail(pool.getFileQuota(nameB).resident, 2)
+        checkPassFail(pool.getStatsSnapshot().files[nameA].evictions, evictionsA)
+        pool.clearFileQuota(nameB);
+
+        // neither pinned pages nor the pages of a reservation are evicted by another file
+        std::vector<PageHandle> pinned;
+        for (PageId i = numFrames + batch + 1; i > numFrames + 1; i--)
+            pinned.push_back(pool.readPage(&fileA, i));
+        pool.setFileQuota(nameA, numFrames / 2, 0);
+        for (PageId i = 1; i <= 2 * numFrames; i++)
+        {
+            // new pages come into dirty frames, which go to disk in batches
+            if (i % 8 == 0)
+                pool.allocPage(&fileB, pageNo).release();
+            pool.readPage(&fileB, i).release();
+        }
+        bool reserved = pool.getFileQuota(nameA).resident >= numFrames / 2;
+        checkPassFail(reserved, true)
+        bool written = pool.getBufStats().dirtyEvictions > 0 && pool.getBufStats().diskwrites > 0;
+        checkPassFail(written, true)
+        const std::uint64_t hits = pool.getBufStats().hits;
+        for (PageId i = numFrames + batch + 1; i > numFrames + 1; i--)
+            pool.readPage(&fileA, i).release();
+        checkPassFail(pool.getBufStats().hits, hits + batch)
+        pinned.clear();
+
+        pool.flushFile(&fileA);
+        pool.flushFile(&fileB);
+    }
+
+    // dirty victims which cannot be written back stay in the pool, so their changes are not lost
+    {
+        PageFile fileA = PageFile::open(nameA);
+        BufMgr pool(numFrames);
+        pool.setReadahead(false);
+        std::vector<RecordId> rids;
+        for (PageId i = 1; i <= numFrames; i++)
+        {
+            PageHandle page = pool.readPage(&fileA, i);
+            page.markDirty();
+            record1.i = i;
+            rids.push_back(page->insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1))));
+        }
+
+        // no file may grow past zero bytes, so every write fails; nothing is printed meanwhile
+        std::cout << std::flush;
+        struct rlimit limit;
+        getrlimit(RLIMIT_FSIZE, &limit);
+        struct rlimit noWrites = limit;
+        noWrites.rlim_cur = 0;
+        signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &noWrites);
+        bool failed = false;
+        try
+        {
+            pool.readPage(&fileA, numFrames + 1).release();
+        }
+        catch(FileIOException e)
+        {
+            failed = true;
+        }
+        setrlimit(RLIMIT_FSIZE, &limit);
+        signal(SIGXFSZ, SIG_DFL);
+        checkPassFail(failed, true)
+        checkPassFail(pool.getBufStats().dirtyEvictions, 0)
+
+        const std::uint64_t hits = pool.getBufStats().hits;
+        for (PageId i = 1; i <= numFrames; i++)
+            pool.readPage(&fileA, i).release();
+        checkPassFail(pool.getBufStats().hits, hits + numFrames)
+        pool.flushFile(&fileA);
+        int lost = 0;
+        for (PageId i = 1; i <= numFrames; i++)
+        {
+            std::string recordStr = fileA.readPage(i).getRecord(rids[i - 1]);
+            if (reinterpret_cast<const RECORD*>(recordStr.data())->i != (int) i)
+                lost++;
+        }
+        checkPassFail(lost, 0)
+    }
+    File::remove(nameA);
+    File::remove(nameB);
+}
+void test33()
+{
+    // Pages are read and allocated straight into the memory given to the file, which for the pool is the frame
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for reading pages into frames" << std::endl;
+    const std::string fileName = "relA.frames";
+    {
+        PageFile pageFile = PageFile::create(fileName);
+        std::vector<PageId> pageNos;
+        for (int i = 0; i < 4; i++)
+        {
+            PageId pageNo;
+            Page page = pageFile.allocatePage(pageNo);
+            record1.i = i;
+            page.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1)));
+            pageFile.writePage(pageNo, page);
+            pageNos.push_back(pageNo);
+        }
+
+        // whatever the page held before is overwritten entirely
+        Page target;
+        target.insertRecord(std::string(100, 'x'));
+        pageFile.readPage(pageNos[2], target);
+        Page byValue = pageFile.readPage(pageNos[2]);
+        checkPassFail(memcmp(&target, &byValue, Page::SIZE), 0)
+
+        BufMgr pool(2);
+        pool.setReadahead(false);
+        PageId newPageNo;
+        {
+            PageHandle page = pool.readPage(&pageFile, pageNos[1]);
+            const bool inFrame = page.get() == pool.bufPool[page.getFrameNo()];
+            checkPassFail(inFrame, true)
+            Page onDisk = pageFile.readPage(pageNos[1]);
+            checkPassFail(memcmp(page.get(), &onDisk, Page::SIZE), 0)
+
+            PageHandle newPage = pool.allocPage(&pageFile, newPageNo);
+            const bool newInFrame = newPage.get() == pool.bufPool[newPage.getFrameNo()];
+            checkPassFail(newInFrame, true)
+            checkPassFail(newPage->page_number(), newPageNo)
+            checkPassFail(newPage->getFreeSpace(), Page::DATA_SIZE)
+        }
+
+        // a frame handed to another page takes it in place, so the frames never move
+        std::vector<const Page*> frames(pool.bufPool.begin(), pool.bufPool.end());
+        for (std::size_t i = 0; i < pageNos.size(); i++)
+        {
+            PageHandle page = pool.readPage(&pageFile, pageNos[i]);
+            RecordId rid = {pageNos[i], 1};
+            std::string recordStr = page->getRecord(rid);
+            checkPassFail(reinterpret_cast<const RECORD*>(recordStr.data())->i, (int) i)
+        }
+        const bool stayed = std::equal(frames.begin(), frames.end(), pool.bufPool.begin());
+        checkPassFail(stayed, true)
+        pool.flushFile(&pageFile);
+        checkPassFail(pageFile.readPage(newPageNo).page_number(), newPageNo)
+    }
+    File::remove(fileName);
+}
+void test34()
+{
+    // The sweep looks at the flags of 64 frames at once; pools past one word must still evict only unpinned frames
+    std::cout << "--------------------" << std::endl;
+    std::cout << "Test for the word-wise clock sweep" << std::endl;
+    {
+        FrameBits bits;
+        bits.resize(130);
+        bits.set(0);
+        bits.set(63);
+        bits.set(64);
+        bits.set(129);
+        const std::uint64_t firstWord = (((std::uint64_t) 1) << 63) | 1;
+        const std::uint64_t one = 1;
+        const std::uint64_t two = 2;
+        checkPassFail(bits.word(0), firstWord)
+        checkPassFail(bits.word(1), one)
+        checkPassFail(bits.word(2), two)
+        bits.reset(63);
+        const bool cleared = !bits.test(63) && bits.test(0) && bits.test(64);
+        checkPassFail(cleared, true)
+
+        // shrinking drops the bits of frames past the end, growing again brings them back clear
+        bits.resize(100);
+        bits.set(99);
+        bits.resize(65);
+        checkPassFail(bits.word(1), one)
+        bits.resize(130);
+        const bool dropped = !bits.test(99) && !bits.test(129) && bits.test(64);
+        checkPassFail(dropped, true)
+    }
+
+    const std::string fileName = "relA.sweep";
+    {
+        const std::uint32_t numFrames = 130;
+        PageFile pageFile = PageFile::create(fileName);
+        for (std::uint32_t i = 0; i < 2 * numFrames; i++)
+        {
+            PageId pageNo;
+            Page page = pageFile.allocatePage(pageNo);
+            pageFile.writePage(pageNo, page);
+        }
+
+        BufMgr pool(numFrames);
+        pool.setReadahead(false);
+
+        // pin all but a few frames, spread over all three words
+        const std::uint32_t numPinned = numFrames - 6;
+        std::vector<PageHandle> pinned;
+        std::vector<FrameId> pinnedFrames;
+        for (PageId i = 1; i <= numPinned; i++)
+        {
+            pinned.push_back(pool.readPage(&pageFile, i));
+            pinnedFrames.push_back(pinned.back().getFrameNo());
+        }
+
+        for (PageId i = numPinned + 1; i <= 2 * numFrames; i++)
+            pool.readPage(&pageFile, i).release();
+        const bool waited = pool.getBufStats().pinWaits > 0;
+        checkPassFail(waited, true)
+
+        // the pinned pages never left their frames
+        const std::uint64_t diskreads = pool.getBufStats().diskreads;
+        bool stayed = true;
+        for (PageId i = 1; i <= numPinned; i++)
+        {
+            PageHandle page = pool.readPage(&pageFile, i);
+            stayed = stayed && page.getFrameNo() == pinnedFrames[i - 1] && page->page_number() == i;
+        }
+        checkPassFail(stayed, true)
+        checkPassFail(pool.getBufStats().diskreads, diskreads)
+
+        // once every frame is pinned there is nothing left to sweep
+        for (PageId i = numPinned + 1; i <= numFrames; i++)
+            pinned.push_back(pool.readPage(&pageFile, i));
+        bool exceeded = false;
+        try
+        {
+            pool.readPage(&pageFile, numFrames + 1);
+        }
+        catch(BufferExceededException e)
+        {
+            exceeded = true;
+        }
+        checkPassFail(exceeded, true)
+
+        // unpinning a single frame makes room again
+        pinned.back().release();
+        PageHandle page = pool.readPage(&pageFile, numFrames + 1);
+        checkPassFail(page->page_number(), numFrames + 1)
+        page.release();
+        pinned.clear();
+        pool.flushFile(&pageFile);
+    }
+    File::remove(fileName);
+}
+bool usedPagesInOrder(PageFile& pageFile, int expected)
+{
+    // Checks that the used list holds the given number of pages in increasing page number order
+    int count = 0;
+    PageId last = Page::INVALID_NUMBER;
+    for (FileIterator iter = pageFile.begin(); iter != pageFile.end(); ++iter)
+    {
+        if ((*iter).page_number() <= last)
+            return false;
+        last = (*iter).page_number();
+        count++;
+    }
+    return count == expected;
+}
+int readRelationInOrder()
+{
+    // Reads every page of the relation through the buffer pool, counting the records found in key order
+    int count = 0;
+    for (FileIterator iter = file1->begin(); iter != file1->end(); ++iter)
+    {
+        PageHandle page = bufMgr->readPage(file1, (*iter).page_number());
+        for (PageIterator recIter = page->begin(); recIter != page->end(); ++recIter)
+        {
+            std::string recordStr = *recIter;
+            const RECORD* myRec = reinterpret_cast<const RECORD*>(recordStr.data());
+            if (myRec->i == count)
+                count++;
+        }
+    }
+    return count;
+}
 void testType(int num)
 {
     if(testNum == 1)
@@ -425,8 +2141,6 @@ void forwardCreateRelationInRange(int left, int right)
 
     // initialize all of record1.s to keep purify happy
     memset(record1.s, ' ', sizeof(record1.s));
-    PageId new_page_number;
-    Page new_page = file1->allocatePage(new_page_number);
 
     // Insert a bunch of tuples into the relation.
     for(int i = left; i <= right; i++ )
@@ -436,22 +2150,10 @@ void forwardCreateRelationInRange(int left, int right)
         record1.d = (double)i;
         std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
 
-        while(1)
-        {
-            try
-            {
-                new_page.insertRecord(new_data);
-                break;
-            }
-            catch(InsufficientSpaceException e)
-            {
-                file1->writePage(new_page_number, new_page);
-                new_page = file1->allocatePage(new_page_number);
-            }
-        }
+        bufMgr->insertRecord(file1, new_data);
     }
-
-    file1->writePage(new_page_number, new_page);
+    // the pages go to disk for the File objects opening the relation by name
+    bufMgr->flushFile(file1);
 }
 
 
@@ -473,8 +2175,6 @@ void backwardCreateRelationInSize(int size)
 
     // initialize all of record1.s to keep purify happy
     memset(record1.s, ' ', sizeof(record1.s));
-    PageId new_page_number;
-    Page new_page = file1->allocatePage(new_page_number);
 
     // Insert a bunch of tuples into the relation.
     for(int i = size - 1; i >= 0; i-- )
@@ -485,22 +2185,9 @@ void backwardCreateRelationInSize(int size)
 
         std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
 
-        while(1)
-        {
-            try
-            {
-                new_page.insertRecord(new_data);
-                break;
-            }
-            catch(InsufficientSpaceException e)
-            {
-                file1->writePage(new_page_number, new_page);
-                new_page = file1->allocatePage(new_page_number);
-            }
-        }
+        bufMgr->insertRecord(file1, new_data);
     }
-
-    file1->writePage(new_page_number, new_page);
+    bufMgr->flushFile(file1);
 }
 
 // -----------------------------------------------------------------------------
@@ -523,8 +2210,6 @@ void forwardCreateRelationInSize(int size)
 
     // initialize all of record1.s to keep purify happy
     memset(record1.s, ' ', sizeof(record1.s));
-    PageId new_page_number;
-    Page new_page = file1->allocatePage(new_page_number);
 
     // Insert a bunch of tuples into the relation.
     for(int i = 0; i < size; i++ )
@@ -534,22 +2219,9 @@ void forwardCreateRelationInSize(int size)
         record1.d = (double)i;
         std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
 
-        while(1)
-        {
-            try
-            {
-                new_page.insertRecord(new_data);
-                break;
-            }
-            catch(InsufficientSpaceException e)
-            {
-                file1->writePage(new_page_number, new_page);
-                new_page = file1->allocatePage(new_page_number);
-            }
-        }
+        bufMgr->insertRecord(file1, new_data);
     }
-
-    file1->writePage(new_page_number, new_page);
+    bufMgr->flushFile(file1);
 }
 
 // -----------------------------------------------------------------------------
@@ -569,8 +2241,6 @@ void randomlyCreateRelationInSize(int size)
 
     // initialize all of record1.s to keep purify happy
     memset(record1.s, ' ', sizeof(record1.s));
-    PageId new_page_number;
-    Page new_page = file1->allocatePage(new_page_number);
 
     // insert records in random order
 
@@ -593,27 +2263,14 @@ void randomlyCreateRelationInSize(int size)
 
         std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
 
-        while(1)
-        {
-            try
-            {
-                new_page.insertRecord(new_data);
-                break;
-            }
-            catch(InsufficientSpaceException e)
-            {
-                file1->writePage(new_page_number, new_page);
-                new_page = file1->allocatePage(new_page_number);
-            }
-        }
+        bufMgr->insertRecord(file1, new_data);
 
         int temp = intvec[size-1-i];
         intvec[size-1-i] = intvec[pos];
         intvec[pos] = temp;
         i++;
     }
-
-    file1->writePage(new_page_number, new_page);
+    bufMgr->flushFile(file1);
 }
 // designed test end
 
@@ -637,8 +2294,6 @@ void createRelationForward()
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
 
   // Insert a bunch of tuples into the relation.
   for(int i = 0; i < relationSize; i++ )
@@ -648,22 +2303,9 @@ void createRelationForward()
     record1.d = (double)i;
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+		bufMgr->insertRecord(file1, new_data);
   }
-
-	file1->writePage(new_page_number, new_page);
+  bufMgr->flushFile(file1);
 }
 
 // -----------------------------------------------------------------------------
@@ -684,8 +2326,6 @@ void createRelationBackward()
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
 
   // Insert a bunch of tuples into the relation.
   for(int i = relationSize - 1; i >= 0; i-- )
@@ -696,22 +2336,9 @@ void createRelationBackward()
 
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+		bufMgr->insertRecord(file1, new_data);
   }
-
-	file1->writePage(new_page_number, new_page);
+  bufMgr->flushFile(file1);
 }
 
 // -----------------------------------------------------------------------------
@@ -732,8 +2359,6 @@ void createRelationRandom()
 
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
 
   // insert records in random order
 
@@ -756,27 +2381,14 @@ void createRelationRandom()
 
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(RECORD));
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-      	file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+		bufMgr->insertRecord(file1, new_data);
 
 		int temp = intvec[relationSize-1-i];
 		intvec[relationSize-1-i] = intvec[pos];
 		intvec[pos] = temp;
 		i++;
   }
-  
-	file1->writePage(new_page_number, new_page);
+  bufMgr->flushFile(file1);
 }
 
 // -----------------------------------------------------------------------------
@@ -900,8 +2512,6 @@ void errorTests()
 	
   // initialize all of record1.s to keep purify happy
   memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
 
   // Insert a bunch of tuples into the relation.
 	for(int i = 0; i <10; i++ ) 
@@ -911,22 +2521,10 @@ void errorTests()
     record1.d = (double)i;
     std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
 
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(InsufficientSpaceException e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+		bufMgr->insertRecord(file1, new_data);
   }
 
-	file1->writePage(new_page_number, new_page);
+  bufMgr->flushFile(file1);
 
   BTreeIndex index(relationName, intIndexName, bufMgr, offsetof(tuple,i), INTEGER);
 	
@@ -6,8 +6,10 @@
  */
 
 #include <cassert>
+#include <cstdlib>
 
 #include <iostream>
+#include <new>
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/invalid_record_exception.h"
 #include "exceptions/invalid_slot_exception.h"
@@ -22,6 +24,26 @@ Page::Page() {
   initialize();
 }
 
+void* Page::operator new(std::size_t size) {
+  void* pointer = NULL;
+  if (posix_memalign(&pointer, ALIGNMENT, size) != 0) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void* Page::operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void Page::operator delete(void* pointer) {
+  std::free(pointer);
+}
+
+void Page::operator delete[](void* pointer) {
+  std::free(pointer);
+}
+
 void Page::initialize() {
   header_.free_space_lower_bound = 0;
   header_.free_space_upper_bound = DATA_SIZE;
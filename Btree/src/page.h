@@ -118,6 +118,18 @@ class Page {
    */
   static const std::size_t DATA_SIZE = SIZE - sizeof(PageHeader);
 
+  /**
+   * Size in bytes of the largest record an empty page has room for, leaving
+   * space for its slot.
+   */
+  static const std::size_t MAX_RECORD_SIZE = DATA_SIZE - sizeof(PageSlot);
+
+  /**
+   * Alignment in bytes of pages allocated with new, large enough for I/O on
+   * files opened with O_DIRECT.
+   */
+  static const std::size_t ALIGNMENT = 4096;
+
   /**
    * Number of page indicating that it's invalid.
    */
@@ -133,6 +145,16 @@ class Page {
    */
   Page();
 
+  /**
+   * Allocate and free pages aligned to ALIGNMENT, so that pages on the heap,
+   * such as the frames of the buffer pool, can be read and written without
+   * copying on files opened with O_DIRECT.
+   */
+  static void* operator new(std::size_t size);
+  static void* operator new[](std::size_t size);
+  static void operator delete(void* pointer);
+  static void operator delete[](void* pointer);
+
   /**
    * Inserts a new record into the page.
    *
@@ -343,5 +365,7 @@ static_assert(Page::SIZE > sizeof(PageHeader),
               "Page size must be large enough to hold header and data.");
 static_assert(Page::DATA_SIZE > 0,
               "Page must have some space to hold data.");
+static_assert(Page::SIZE % Page::ALIGNMENT == 0,
+              "Page size must be a multiple of the page alignment.");
 
 }
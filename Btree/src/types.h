@@ -24,6 +24,11 @@ typedef std::uint16_t SlotId;
  */
 typedef std::uint32_t FrameId;
 
+/**
+ * @brief Identifier for an open file, shared by all File objects using it.
+ */
+typedef std::uint32_t FileId;
+
 /**
  * @brief Identifier for a record in a page.
  */
@@ -0,0 +1,108 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <cstdio>
+#include "victimCache.h"
+#include "exceptions/file_not_found_exception.h"
+
+namespace badgerdb {
+
+VictimCache::VictimCache(const std::string& cachePath, const std::uint32_t slots)
+	: path(cachePath), numSlots(slots), slotKeys(slots), slotUsed(slots, false), replaceHand(0)
+{
+  stream.open(path.c_str(), std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!stream.is_open())
+    throw FileNotFoundException(path);
+
+  // hand out the low slots first so that the file only grows as far as it is used
+  for (std::uint32_t i = slots; i > 0; i--)
+    freeSlots.push_back(i - 1);
+}
+
+VictimCache::~VictimCache()
+{
+  stream.close();
+  std::remove(path.c_str());
+}
+
+void VictimCache::remove(std::map<Key, std::uint32_t>::iterator it)
+{
+  slotUsed[it->second] = false;
+  freeSlots.push_back(it->second);
+  directory.erase(it);
+}
+
+bool VictimCache::insert(const File* file, const PageId pageNo, const Page& page)
+{
+  if (numSlots == 0)
+    return false;
+
+  Key key(file, pageNo);
+  std::uint32_t slot;
+  std::map<Key, std::uint32_t>::iterator it = directory.find(key);
+  if (it != directory.end())
+    slot = it->second;
+  else
+  {
+    if (freeSlots.empty())
+    {
+      // all slots are taken, replace the pages in slot order
+      while (!slotUsed[replaceHand])
+        replaceHand = (replaceHand + 1) % numSlots;
+      remove(directory.find(slotKeys[replaceHand]));
+      replaceHand = (replaceHand + 1) % numSlots;
+    }
+    slot = freeSlots.back();
+    freeSlots.pop_back();
+    slotKeys[slot] = key;
+    slotUsed[slot] = true;
+    it = directory.insert(std::make_pair(key, slot)).first;
+  }
+
+  stream.seekp((std::streamoff) slot * Page::SIZE, std::ios::beg);
+  stream.write(reinterpret_cast<const char*>(&page), Page::SIZE);
+  if (!stream)
+  {
+    stream.clear();
+    remove(it);
+    return false;
+  }
+  return true;
+}
+
+bool VictimCache::take(const File* file, const PageId pageNo, Page& page)
+{
+  std::map<Key, std::uint32_t>::iterator it = directory.find(std::make_pair(file, pageNo));
+  if (it == directory.end())
+    return false;
+
+  stream.seekg((std::streamoff) it->second * Page::SIZE, std::ios::beg);
+  stream.read(reinterpret_cast<char*>(&page), Page::SIZE);
+  remove(it);
+  if (!stream)
+  {
+    stream.clear();
+    return false;
+  }
+  return true;
+}
+
+void VictimCache::erase(const File* file, const PageId pageNo)
+{
+  std::map<Key, std::uint32_t>::iterator it = directory.find(std::make_pair(file, pageNo));
+  if (it != directory.end())
+    remove(it);
+}
+
+void VictimCache::eraseFile(const File* file)
+{
+  std::map<Key, std::uint32_t>::iterator it = directory.lower_bound(std::make_pair(file, (PageId) 0));
+  while (it != directory.end() && it->first.first == file)
+    remove(it++);
+}
+
+}
@@ -0,0 +1,136 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "file.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+* @brief Cache file holding clean pages evicted from the buffer pool
+*
+* The cache file is meant to sit on a faster local device than the files it caches. It is split into slots of
+* one page each, and an in-memory directory maps (file, page number) to the slot holding the page. When all
+* slots are taken, new pages replace the held ones in slot order. The cache file is created when the cache is
+* constructed and removed when it is destroyed; its contents are not kept across runs.
+*
+* @warning This class is not threadsafe.
+*/
+class VictimCache
+{
+ private:
+  typedef std::pair<const File*, PageId> Key;
+
+	/**
+	 * Name of the cache file
+	 */
+  std::string path;
+
+	/**
+	 * Stream of the cache file
+	 */
+  std::fstream stream;
+
+	/**
+	 * Number of page slots in the cache file
+	 */
+  std::uint32_t numSlots;
+
+	/**
+	 * Slot of every page held, by (file, page number)
+	 */
+  std::map<Key, std::uint32_t> directory;
+
+	/**
+	 * Page held by every slot; slots in use are marked in slotUsed
+	 */
+  std::vector<Key> slotKeys;
+
+	/**
+	 * True for the slots holding a page
+	 */
+  std::vector<bool> slotUsed;
+
+	/**
+	 * Slots which do not hold a page
+	 */
+  std::vector<std::uint32_t> freeSlots;
+
+	/**
+	 * Next slot to be replaced once all slots are taken
+	 */
+  std::uint32_t replaceHand;
+
+	/**
+	 * Frees the slot of the given directory entry
+	 */
+  void remove(std::map<Key, std::uint32_t>::iterator it);
+
+ public:
+	/**
+   * Constructor of VictimCache class. Creates the cache file, replacing any file of that name.
+	 *
+	 * @param cachePath	Name of the cache file
+	 * @param slots    	Number of pages the cache file holds
+   * @throws  FileNotFoundException If the cache file cannot be created
+	 */
+  VictimCache(const std::string& cachePath, const std::uint32_t slots);
+
+	/**
+   * Destructor of VictimCache class. Removes the cache file.
+	 */
+  ~VictimCache();
+
+	/**
+   * Returns the name of the cache file.
+	 */
+  const std::string& filename() const { return path; }
+
+	/**
+   * Returns the number of pages currently held.
+	 */
+  std::size_t size() const { return directory.size(); }
+
+	/**
+	 * Writes a page to the cache file, replacing any older copy.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param page  	Page contents, which must match the page on disk
+	 * @return  			true if the page was written
+	 */
+  bool insert(const File* file, const PageId pageNo, const Page& page);
+
+	/**
+	 * Moves a page out of the cache: on success the page is read into the given page and its slot is freed.
+	 *
+	 * @param file   	File object
+	 * @param pageNo  Page number in the file
+	 * @param page  	Page to read into
+	 * @return  			true if the page was held by the cache
+	 */
+  bool take(const File* file, const PageId pageNo, Page& page);
+
+	/**
+	 * Drops the copy of a page, if any.
+	 */
+  void erase(const File* file, const PageId pageNo);
+
+	/**
+	 * Drops the copies of all pages of a file.
+	 */
+  void eraseFile(const File* file);
+};
+
+}